@@ -0,0 +1,97 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+const std::size_t Arena::ALIGN;
+const std::size_t Arena::MAX_BLOCK;
+const std::size_t Arena::CHUNK_SIZE;
+
+// the arena of each thread, and how many scopes are open on it
+static thread_local Arena thread_arena;
+static thread_local std::size_t thread_scopes = 0;
+
+Arena::Arena() noexcept: pos(nullptr), end(nullptr){
+  std::fill(std::begin(free_lists), std::end(free_lists), nullptr);
+}
+
+Arena::~Arena(){
+  for(char * chunk : chunks){
+    ::operator delete(chunk);
+  }
+}
+
+void * Arena::allocate(std::size_t size){
+
+  if(size > MAX_BLOCK){
+    return ::operator new(size);
+  }
+
+  size = std::max<std::size_t>((size + ALIGN - 1) & ~(ALIGN - 1), ALIGN);
+
+  FreeBlock * & free_list = free_lists[size / ALIGN - 1];
+  if(free_list != nullptr){
+    FreeBlock * block = free_list;
+    free_list = block->next;
+    return block;
+  }
+
+  if(static_cast<std::size_t>(end - pos) < size){
+    // the rest of the current chunk is abandoned until release
+    pos = static_cast<char *>(::operator new(CHUNK_SIZE));
+    end = pos + CHUNK_SIZE;
+    chunks.push_back(pos);
+  }
+
+  void * block = pos;
+  pos += size;
+  return block;
+}
+
+void Arena::deallocate(void * block, std::size_t size) noexcept{
+
+  if(size > MAX_BLOCK){
+    ::operator delete(block);
+    return;
+  }
+
+  size = std::max<std::size_t>((size + ALIGN - 1) & ~(ALIGN - 1), ALIGN);
+
+  FreeBlock * freed = static_cast<FreeBlock *>(block);
+  freed->next = free_lists[size / ALIGN - 1];
+  free_lists[size / ALIGN - 1] = freed;
+}
+
+void Arena::release() noexcept{
+
+  std::fill(std::begin(free_lists), std::end(free_lists), nullptr);
+
+  if(chunks.empty()){
+    return;
+  }
+
+  for(std::size_t i = 1; i < chunks.size(); ++i){
+    ::operator delete(chunks[i]);
+  }
+  chunks.resize(1);
+
+  pos = chunks.front();
+  end = pos + CHUNK_SIZE;
+}
+
+std::size_t Arena::reserved() const noexcept{
+  return chunks.size() * CHUNK_SIZE;
+}
+
+Arena * Arena::current() noexcept{
+  return (thread_scopes > 0) ? &thread_arena : nullptr;
+}
+
+ArenaScope::ArenaScope() noexcept{
+  ++thread_scopes;
+}
+
+ArenaScope::~ArenaScope(){
+  if(--thread_scopes == 0){
+    thread_arena.release();
+  }
+}
@@ -0,0 +1,134 @@
+/*! \file arena.hpp
+Defines the arena that evaluation temporaries are allocated from.
+
+Evaluating a program creates and destroys large numbers of short-lived
+objects: continuation stacks, lambda scope frames and their parameter slots.
+Allocating them through global new and delete dominates the cost of calling
+a lambda, so they come from a per-thread Arena instead. Nothing that is
+allocated from the arena may outlive the evaluation that allocated it;
+results and definitions are Expressions, which are always on the heap.
+ */
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*! \class Arena
+\brief A bump allocator with free lists and bulk release.
+
+Blocks are carved out of large chunks. A freed block is kept on a free list
+for its size and handed out again by the next allocation of that size, so a
+loop that allocates and frees in turn, such as a tail recursive lambda,
+runs in constant space. Large blocks go to the heap. Everything is released
+at once by release.
+ */
+class Arena {
+public:
+
+  /// Construct an empty arena
+  Arena() noexcept;
+
+  /// Destroy the arena, returning its chunks to the heap
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  /// allocate size bytes, aligned for any type up to 16 bytes
+  void * allocate(std::size_t size);
+
+  /// return a block of size bytes obtained from allocate
+  void deallocate(void * block, std::size_t size) noexcept;
+
+  /// free every block at once, keeping the first chunk for reuse
+  void release() noexcept;
+
+  /// the number of bytes held in chunks
+  std::size_t reserved() const noexcept;
+
+  /*! The arena of the calling thread while an ArenaScope is open on it.
+    \return the arena, or nullptr outside any ArenaScope
+   */
+  static Arena * current() noexcept;
+
+private:
+
+  // blocks are multiples of ALIGN bytes, and larger than MAX_BLOCK go to the heap
+  static const std::size_t ALIGN = 16;
+  static const std::size_t MAX_BLOCK = 4096;
+  static const std::size_t CHUNK_SIZE = 64 * 1024;
+
+  std::vector<char *> chunks;
+
+  // the unused part of the last chunk
+  char * pos;
+  char * end;
+
+  // a free list of blocks for each size
+  struct FreeBlock { FreeBlock * next; };
+  FreeBlock * free_lists[MAX_BLOCK / ALIGN];
+};
+
+/*! \class ArenaScope
+\brief Marks the extent of an evaluation that allocates from its thread's
+Arena.
+
+Scopes nest. When the outermost one closes, every block allocated from the
+thread's arena is released at once, so each object allocated while it was
+open must have been destroyed by then.
+ */
+class ArenaScope {
+public:
+
+  /// open a scope on the calling thread's arena
+  ArenaScope() noexcept;
+
+  /// close the scope, releasing the arena if it is the outermost
+  ~ArenaScope();
+
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope & operator=(const ArenaScope &) = delete;
+};
+
+/*! \class ArenaAllocator
+\brief A standard allocator over an Arena, for containers and
+std::allocate_shared. Constructed without an arena it uses the heap.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  /// an allocator from arena, or from the heap if arena is nullptr
+  explicit ArenaAllocator(Arena * arena = nullptr) noexcept : arena(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> & other) noexcept : arena(other.arena) {}
+
+  T * allocate(std::size_t n){
+    std::size_t size = n * sizeof(T);
+    return static_cast<T *>(arena ? arena->allocate(size) : ::operator new(size));
+  }
+
+  void deallocate(T * block, std::size_t n) noexcept{
+    if(arena) arena->deallocate(block, n * sizeof(T));
+    else ::operator delete(block);
+  }
+
+  /// the arena allocated from, or nullptr for the heap
+  Arena * arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> & left, const ArenaAllocator<U> & right) noexcept{
+  return left.arena == right.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> & left, const ArenaAllocator<U> & right) noexcept{
+  return left.arena != right.arena;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "catch.hpp"
+
+#include "arena.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+TEST_CASE( "Test arena allocation", "[arena]" ) {
+
+  Arena arena;
+  REQUIRE(arena.reserved() == 0);
+
+  INFO("blocks are aligned and distinct");
+  void * a = arena.allocate(1);
+  void * b = arena.allocate(24);
+  void * c = arena.allocate(0);
+  REQUIRE(reinterpret_cast<std::uintptr_t>(a) % 16 == 0);
+  REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 16 == 0);
+  REQUIRE(reinterpret_cast<std::uintptr_t>(c) % 16 == 0);
+  REQUIRE(a != b);
+  REQUIRE(b != c);
+
+  INFO("a freed block is reused by the next allocation of its size");
+  arena.deallocate(b, 24);
+  REQUIRE(arena.allocate(32) == b);
+
+  INFO("large blocks come from the heap");
+  std::size_t reserved = arena.reserved();
+  void * big = arena.allocate(1 << 20);
+  REQUIRE(arena.reserved() == reserved);
+  arena.deallocate(big, 1 << 20);
+
+  INFO("release keeps one chunk and starts over");
+  for(int i = 0; i < 100000; ++i){
+    arena.allocate(64);
+  }
+  REQUIRE(arena.reserved() > reserved);
+  arena.release();
+  REQUIRE(arena.reserved() == reserved);
+  REQUIRE(arena.allocate(1) == a);
+}
+
+TEST_CASE( "Test allocating and freeing in a loop runs in constant space", "[arena]" ) {
+
+  Arena arena;
+  ArenaAllocator<int> alloc(&arena);
+
+  for(int i = 0; i < 100000; ++i){
+    std::shared_ptr<std::vector<int, ArenaAllocator<int>>> v =
+      std::allocate_shared<std::vector<int, ArenaAllocator<int>>>(alloc, 10, i, alloc);
+    REQUIRE((*v)[9] == i);
+  }
+
+  REQUIRE(arena.reserved() == 64 * 1024);
+}
+
+TEST_CASE( "Test arena scopes", "[arena]" ) {
+
+  REQUIRE(Arena::current() == nullptr);
+
+  INFO("an allocator without an arena uses the heap");
+  std::vector<int, ArenaAllocator<int>> heap(ArenaAllocator<int>(Arena::current()));
+  heap.assign(1000, 1);
+  REQUIRE(heap.get_allocator().arena == nullptr);
+
+  {
+    ArenaScope outer;
+    Arena * arena = Arena::current();
+    REQUIRE(arena != nullptr);
+
+    void * block = arena->allocate(16);
+    {
+      ArenaScope inner;
+      REQUIRE(Arena::current() == arena);
+    }
+
+    INFO("closing an inner scope does not release the arena");
+    void * next = arena->allocate(16);
+    REQUIRE(next != block);
+  }
+
+  REQUIRE(Arena::current() == nullptr);
+}
@@ -0,0 +1,412 @@
+#include "ast_cache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+// format version, bump when the encoding changes
+static const std::uint32_t CACHE_VERSION = 1;
+
+// written as is, so a cache from a machine of the other byte order is rejected
+static const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// the fixed header at the start of a cache file
+struct CacheHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t reserved;
+  std::uint64_t source_hash;
+  std::uint64_t source_size;
+  std::uint64_t payload_hash;
+};
+
+// node tags: the Atom kind in the low bits, then flags
+enum : unsigned char {
+  TAG_NONE = 0,
+  TAG_NUMBER = 1,
+  TAG_SYMBOL = 2,
+  TAG_COMPLEX = 3,
+  TAG_STRING = 4,
+  TAG_KIND = 0x0f,
+  TAG_PACKED_NUMBERS = 0x10,
+  TAG_PACKED_COMPLEX = 0x20,
+  TAG_TAIL = 0x40,
+  TAG_PROPERTIES = 0x80
+};
+
+std::uint64_t content_hash(const char * data, std::size_t size) noexcept{
+  std::uint64_t hash = 14695981039346656037ULL;
+  for(std::size_t i = 0; i < size; ++i){
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// append an unsigned LEB128 integer
+static void put_varint(std::string & out, std::uint64_t value){
+  while(value >= 0x80){
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// append the raw bytes of a double
+static void put_double(std::string & out, double value){
+  out.append(reinterpret_cast<const char *>(&value), sizeof(double));
+}
+
+void AstWriter::write(const Expression & exp){
+
+  // pre-order, so each node is followed by its tail and then its property values
+  std::vector<const Expression *> stack(1, &exp);
+
+  while(!stack.empty()){
+    const Expression * node = stack.back();
+    stack.pop_back();
+
+    const Atom & head = node->head();
+    const PackedTail * packed = node->packed();
+    const PropertyList & properties = node->getPropertyList();
+
+    unsigned char tag = TAG_NONE;
+    if(head.isNumber()) tag = TAG_NUMBER;
+    else if(head.isSymbol()) tag = TAG_SYMBOL;
+    else if(head.isComplex()) tag = TAG_COMPLEX;
+    else if(head.isString()) tag = TAG_STRING;
+    if(packed) tag |= packed->complex ? TAG_PACKED_COMPLEX : TAG_PACKED_NUMBERS;
+    else if(node->tailLength() > 0) tag |= TAG_TAIL;
+    if(!properties.empty()) tag |= TAG_PROPERTIES;
+    m_out.push_back(static_cast<char>(tag));
+
+    switch(tag & TAG_KIND){
+    case TAG_NUMBER:
+      put_double(m_out, head.asNumber());
+      break;
+    case TAG_COMPLEX:
+      put_double(m_out, head.asComplex().real());
+      put_double(m_out, head.asComplex().imag());
+      break;
+    case TAG_SYMBOL:
+    case TAG_STRING: {
+      // the index of a symbol seen before, or a new index followed by its text
+      SymbolId id = head.asSymbolId();
+      auto found = m_symbols.find(id);
+      if(found != m_symbols.end()){
+        put_varint(m_out, found->second);
+      }
+      else{
+        std::size_t index = m_symbols.size();
+        m_symbols.emplace(id, index);
+        put_varint(m_out, index);
+        put_varint(m_out, id->size());
+        m_out.append(*id);
+      }
+      break;
+    }
+    }
+
+    if(packed){
+      put_varint(m_out, packed->size());
+      if(packed->complex){
+        for(const auto & value : packed->complexes){
+          put_double(m_out, value.real());
+          put_double(m_out, value.imag());
+        }
+      }
+      else{
+        m_out.append(reinterpret_cast<const char *>(packed->numbers.data()), packed->numbers.size() * sizeof(double));
+      }
+    }
+    else if(tag & TAG_TAIL){
+      put_varint(m_out, node->tailLength());
+    }
+
+    if(!properties.empty()){
+      put_varint(m_out, properties.size());
+      for(const auto & property : properties){
+        put_varint(m_out, property.first->size());
+        m_out.append(*property.first);
+      }
+      for(const PropertyList::Entry * it = properties.end(); it != properties.begin();){
+        stack.push_back(&(--it)->second);
+      }
+    }
+
+    if(tag & TAG_TAIL){
+      const std::vector<Expression> & tail = node->getTail();
+      for(auto it = tail.rbegin(); it != tail.rend(); ++it){
+        stack.push_back(&*it);
+      }
+    }
+  }
+}
+
+const std::string & AstWriter::bytes() const noexcept{
+  return m_out;
+}
+
+AstReader::AstReader(const char * data, std::size_t size): m_pos(data), m_end(data + size) {}
+
+bool AstReader::atEnd() const noexcept{
+  return m_pos == m_end;
+}
+
+// read an unsigned LEB128 integer
+static bool get_varint(const char *& pos, const char * end, std::uint64_t & value){
+  value = 0;
+  for(int shift = 0; shift < 64; shift += 7){
+    if(pos == end) return false;
+    unsigned char byte = static_cast<unsigned char>(*pos++);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+// read the raw bytes of a double
+static bool get_double(const char *& pos, const char * end, double & value){
+  if(static_cast<std::size_t>(end - pos) < sizeof(double)) return false;
+  std::memcpy(&value, pos, sizeof(double));
+  pos += sizeof(double);
+  return true;
+}
+
+// read a length-prefixed string
+static bool get_string(const char *& pos, const char * end, std::string & text){
+  std::uint64_t length;
+  if(!get_varint(pos, end, length) || length > static_cast<std::uint64_t>(end - pos)) return false;
+  text.assign(pos, static_cast<std::size_t>(length));
+  pos += length;
+  return true;
+}
+
+// a node whose children are still being read
+struct ReadFrame {
+  Expression node;
+  std::uint64_t tail;
+  std::vector<Expression> children;
+  std::vector<std::string> keys;
+  std::vector<Expression> values;
+};
+
+bool AstReader::read(Expression & exp){
+
+  std::vector<ReadFrame> stack;
+
+  while(true){
+    if(m_pos == m_end) return false;
+    unsigned char tag = static_cast<unsigned char>(*m_pos++);
+
+    Atom head;
+    switch(tag & TAG_KIND){
+    case TAG_NONE:
+      break;
+    case TAG_NUMBER: {
+      double value;
+      if(!get_double(m_pos, m_end, value)) return false;
+      head = Atom(value);
+      break;
+    }
+    case TAG_COMPLEX: {
+      double real, imag;
+      if(!get_double(m_pos, m_end, real) || !get_double(m_pos, m_end, imag)) return false;
+      head = Atom(std::complex<double>(real, imag));
+      break;
+    }
+    case TAG_SYMBOL:
+    case TAG_STRING: {
+      std::uint64_t index;
+      if(!get_varint(m_pos, m_end, index) || index > m_symbols.size()) return false;
+      if(index == m_symbols.size()){
+        std::string text;
+        if(!get_string(m_pos, m_end, text)) return false;
+        m_symbols.emplace_back(text);
+      }
+      head = m_symbols[static_cast<std::size_t>(index)];
+      break;
+    }
+    default:
+      return false;
+    }
+
+    Expression node(head);
+    std::uint64_t tail = 0;
+    std::vector<std::string> keys;
+
+    if(tag & (TAG_PACKED_NUMBERS | TAG_PACKED_COMPLEX)){
+      bool complex = (tag & TAG_PACKED_COMPLEX) != 0;
+      std::uint64_t count;
+      std::size_t width = complex ? 2 * sizeof(double) : sizeof(double);
+      if(!get_varint(m_pos, m_end, count) || count > static_cast<std::uint64_t>(m_end - m_pos) / width) return false;
+      if(complex){
+        std::vector<std::complex<double>> values(static_cast<std::size_t>(count));
+        for(auto & value : values){
+          double real, imag;
+          if(!get_double(m_pos, m_end, real) || !get_double(m_pos, m_end, imag)) return false;
+          value = std::complex<double>(real, imag);
+        }
+        node = Expression(values);
+      }
+      else{
+        std::vector<double> values(static_cast<std::size_t>(count));
+        std::memcpy(values.data(), m_pos, values.size() * sizeof(double));
+        m_pos += values.size() * sizeof(double);
+        node = Expression(values);
+      }
+    }
+    else if(tag & TAG_TAIL){
+      // every child takes at least a byte, which bounds a malformed count
+      if(!get_varint(m_pos, m_end, tail) || tail > static_cast<std::uint64_t>(m_end - m_pos)) return false;
+    }
+
+    if(tag & TAG_PROPERTIES){
+      std::uint64_t count;
+      if(!get_varint(m_pos, m_end, count) || count > static_cast<std::uint64_t>(m_end - m_pos)) return false;
+      keys.resize(static_cast<std::size_t>(count));
+      for(auto & key : keys){
+        if(!get_string(m_pos, m_end, key)) return false;
+      }
+    }
+
+    // a node with children waits for them on the stack
+    if(tail > 0 || !keys.empty()){
+      stack.emplace_back();
+      ReadFrame & frame = stack.back();
+      frame.node = node;
+      frame.tail = tail;
+      frame.children.reserve(static_cast<std::size_t>(tail));
+      frame.keys.swap(keys);
+      continue;
+    }
+
+    // a complete node goes to its parent, which may complete in turn
+    while(true){
+      if(stack.empty()){
+        exp = node;
+        return true;
+      }
+
+      ReadFrame & parent = stack.back();
+      if(parent.tail > 0){
+        parent.children.push_back(node);
+        --parent.tail;
+      }
+      else{
+        parent.values.push_back(node);
+      }
+      if(parent.tail > 0 || parent.values.size() < parent.keys.size()){
+        break;
+      }
+
+      node = parent.node;
+      if(!parent.children.empty()){
+        // the tail is built in one allocation, then the head restored
+        node = Expression(parent.children);
+        node.head() = parent.node.head();
+      }
+      if(!parent.keys.empty()){
+        PropertyList properties;
+        for(std::size_t i = 0; i < parent.keys.size(); ++i){
+          properties.set(intern(parent.keys[i]), parent.values[i]);
+        }
+        node.setPropertyList(properties);
+      }
+      stack.pop_back();
+    }
+  }
+}
+
+CachedProgram::CachedProgram(const std::string & path):
+  m_path(path), m_source(path), m_hash(0) {
+
+  if(!m_source.isOpen()) return;
+  m_hash = content_hash(m_source.data(), m_source.size());
+
+  std::unique_ptr<MappedFile> cache(new MappedFile(m_path + ".cache"));
+  if(cache->isOpen() && cache->size() >= sizeof(CacheHeader)){
+    CacheHeader header;
+    std::memcpy(&header, cache->data(), sizeof(CacheHeader));
+    const char * payload = cache->data() + sizeof(CacheHeader);
+    std::size_t size = cache->size() - sizeof(CacheHeader);
+
+    if(std::memcmp(header.magic, "PLSC", 4) == 0 && header.version == CACHE_VERSION &&
+       header.byte_order == BYTE_ORDER_MARK && header.source_hash == m_hash &&
+       header.source_size == m_source.size() && header.payload_hash == content_hash(payload, size)){
+      m_reader.reset(new AstReader(payload, size));
+      m_cache = std::move(cache);
+      return;
+    }
+  }
+
+  m_parser.reset(new StreamParser(m_source.data(), m_source.size()));
+  m_writer.reset(new AstWriter);
+}
+
+bool CachedProgram::isOpen() const noexcept{
+  return m_source.isOpen();
+}
+
+bool CachedProgram::fromCache() const noexcept{
+  return m_reader != nullptr;
+}
+
+StreamParser::Status CachedProgram::next(Expression & form){
+
+  if(!isOpen()) return StreamParser::ERROR;
+
+  if(m_reader){
+    if(m_reader->atEnd()) return StreamParser::END;
+    return m_reader->read(form) ? StreamParser::FORM : StreamParser::ERROR;
+  }
+
+  StreamParser::Status status = m_parser->next(form);
+  if(status == StreamParser::FORM && m_writer){
+    m_writer->write(form);
+  }
+  else if(status == StreamParser::END && m_writer){
+    store();
+    m_writer.reset();
+  }
+  else if(status == StreamParser::ERROR){
+    m_writer.reset();
+  }
+  return status;
+}
+
+void CachedProgram::store(){
+
+  CacheHeader header;
+  std::memcpy(header.magic, "PLSC", 4);
+  header.version = CACHE_VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.reserved = 0;
+  header.source_hash = m_hash;
+  header.source_size = m_source.size();
+  header.payload_hash = content_hash(m_writer->bytes().data(), m_writer->bytes().size());
+
+  // write a private file and rename it into place, so concurrent kernels
+  // never see a partial cache
+  std::size_t unique = std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+    static_cast<std::size_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+  std::string temp = m_path + ".cache." + std::to_string(unique);
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if(!out) return;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(CacheHeader));
+    out.write(m_writer->bytes().data(), m_writer->bytes().size());
+    if(!out){
+      out.close();
+      std::remove(temp.c_str());
+      return;
+    }
+  }
+  if(std::rename(temp.c_str(), (m_path + ".cache").c_str()) != 0){
+    std::remove(temp.c_str());
+  }
+}
@@ -0,0 +1,124 @@
+/*! \file ast_cache.hpp
+Defines the binary AST format and the cached program reader.
+ */
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+#include "mapped_file.hpp"
+#include "parse.hpp"
+
+/*! \fn std::uint64_t content_hash(const char * data, std::size_t size)
+\brief Hash a buffer (64-bit FNV-1a), used to key caches by content
+ */
+std::uint64_t content_hash(const char * data, std::size_t size) noexcept;
+
+/*! \class AstWriter
+\brief Serializes Expressions into the compact binary AST format.
+
+Each node is a tag byte with its Atom's kind, its Atom's value, and the
+number of tail elements and properties, followed by those children in order.
+Packed lists are written as their raw values. Symbols and strings are
+written once and then referred to by index, so they are also interned once
+when read back. Trees of any depth are written without recursion.
+ */
+class AstWriter {
+public:
+
+  /// append the binary form of exp
+  void write(const Expression & exp);
+
+  /// return the bytes written so far
+  const std::string & bytes() const noexcept;
+
+private:
+
+  // the output
+  std::string m_out;
+
+  // index of each symbol or string written so far
+  std::unordered_map<SymbolId, std::size_t> m_symbols;
+};
+
+/*! \class AstReader
+\brief Reads Expressions written by AstWriter from a buffer.
+ */
+class AstReader {
+public:
+
+  /// Construct a reader of the size bytes at data, which must outlive it
+  AstReader(const char * data, std::size_t size);
+
+  /*! Read the next Expression
+    \param exp set to the Expression read
+    \return false at the end of the buffer or if the data is malformed
+   */
+  bool read(Expression & exp);
+
+  /// true once every byte has been read
+  bool atEnd() const noexcept;
+
+private:
+
+  const char * m_pos;
+  const char * m_end;
+
+  // the Atom of each symbol or string read so far
+  std::vector<Atom> m_symbols;
+};
+
+/*! \class CachedProgram
+\brief Reads the top-level forms of a plotscript file, from a binary cache
+of its AST when one is current.
+
+The cache is kept next to the source as "<path>.cache" and is keyed by a
+hash of the source's content, so any edit invalidates it. When it is
+current, forms are read straight from the mapped cache with no tokenizing
+or parsing. Otherwise the source is parsed with a StreamParser and, once
+every form has parsed, the cache is written for next time. A cache that
+cannot be written (for example in a read-only directory) is skipped.
+ */
+class CachedProgram {
+public:
+
+  /// Open the program at path; check isOpen for success
+  explicit CachedProgram(const std::string & path);
+
+  /// true if the source could be opened
+  bool isOpen() const noexcept;
+
+  /// true if the forms are being read from the cache
+  bool fromCache() const noexcept;
+
+  /*! Read the next top-level form, as StreamParser::next
+    \param form set to the form read when the result is FORM
+    \return the outcome
+   */
+  StreamParser::Status next(Expression & form);
+
+private:
+
+  std::string m_path;
+  MappedFile m_source;
+  std::uint64_t m_hash;
+
+  // the cache, when current, and the reader over its forms
+  std::unique_ptr<MappedFile> m_cache;
+  std::unique_ptr<AstReader> m_reader;
+
+  // the parser and the cache being written, otherwise
+  std::unique_ptr<StreamParser> m_parser;
+  std::unique_ptr<AstWriter> m_writer;
+
+  // write the cache file from m_writer
+  void store();
+};
+
+#endif
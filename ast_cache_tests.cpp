@@ -0,0 +1,170 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ast_cache.hpp"
+#include "parse.hpp"
+
+// parse a single form from text
+static Expression parse_text(const std::string & program){
+  std::istringstream iss(program);
+  return parse(tokenize(iss));
+}
+
+TEST_CASE( "Test AST serialization round trip", "[ast_cache]" ) {
+
+  std::vector<Expression> expressions = {
+    Expression(),
+    Expression(Atom(3.5)),
+    Expression(Atom(std::complex<double>(1, -2))),
+    Expression(Atom("\"a string\"")),
+    parse_text("(begin (define f (lambda (x) (* x x))) (f 3) (f \"s\") (f f))"),
+    Expression(std::vector<double>{1, 2, 3.25}),
+    Expression(std::vector<std::complex<double>>{{1, 2}, {3, 4}})
+  };
+
+  Expression point = Expression::makeList({Expression(Atom(1.)), Expression(Atom(2.))});
+  point.setProperty("\"object-name\"", Expression(Atom("\"point\"")));
+  point.setProperty("\"size\"", Expression(Atom(0.)));
+  Expression plot = Expression::makeList({point, parse_text("(a (b c))")});
+  plot.setProperty("\"nested\"", point);
+  expressions.push_back(plot);
+
+  AstWriter writer;
+  for(auto & exp : expressions){
+    writer.write(exp);
+  }
+
+  AstReader reader(writer.bytes().data(), writer.bytes().size());
+  Expression readPlot;
+  for(auto & exp : expressions){
+    Expression read;
+    REQUIRE(reader.read(read));
+    REQUIRE(read == exp);
+    REQUIRE(read.getPropertyList().size() == exp.getPropertyList().size());
+    REQUIRE((read.packed() == nullptr) == (exp.packed() == nullptr));
+    readPlot = read;
+  }
+  REQUIRE(reader.atEnd());
+
+  Expression read;
+  REQUIRE(reader.read(read) == false);
+
+  // the nested property survives the reader, not just the original
+  REQUIRE(readPlot.getProperty("\"nested\"").getProperty("\"object-name\"") == Expression(Atom("\"point\"")));
+
+  // truncated data is rejected rather than misread
+  AstReader truncated(writer.bytes().data(), writer.bytes().size() - 1);
+  for(std::size_t i = 0; i + 1 < expressions.size(); ++i){
+    REQUIRE(truncated.read(read));
+  }
+  REQUIRE(truncated.read(read) == false);
+}
+
+TEST_CASE( "Test AST serialization of deep trees", "[ast_cache]" ) {
+
+  const int depth = 100000;
+  std::string program;
+  for(int i = 0; i < depth; ++i) program += "(+ 1 ";
+  program += "1";
+  for(int i = 0; i < depth; ++i) program += ")";
+
+  // compare as bools, since Catch would print the expressions, recursively
+  Expression exp = parse_text(program);
+  bool parsed = (exp != Expression());
+  REQUIRE(parsed);
+
+  AstWriter writer;
+  writer.write(exp);
+
+  AstReader reader(writer.bytes().data(), writer.bytes().size());
+  Expression read;
+  REQUIRE(reader.read(read));
+  REQUIRE(reader.atEnd());
+
+  // == recurses, so compare what the trees serialize to
+  AstWriter rewriter;
+  rewriter.write(read);
+  bool same = (rewriter.bytes() == writer.bytes());
+  REQUIRE(same);
+}
+
+TEST_CASE( "Test cached program", "[ast_cache]" ) {
+
+  std::string path = "ast_cache_test.pls";
+  std::string program = "(define a 1) ; comment\n(define b (list a \"two\" (+ a 2)))\n";
+  std::remove((path + ".cache").c_str());
+  {
+    std::ofstream ofs(path);
+    ofs << program;
+  }
+
+  std::vector<Expression> parsed = {parse_text("(define a 1)"), parse_text("(define b (list a \"two\" (+ a 2)))")};
+
+  // reads all forms, from the parser the first time and then from the cache
+  for(bool cached : {false, true}){
+    CachedProgram source(path);
+    REQUIRE(source.isOpen());
+    REQUIRE(source.fromCache() == cached);
+
+    Expression form;
+    for(auto & exp : parsed){
+      REQUIRE(source.next(form) == StreamParser::FORM);
+      REQUIRE(form == exp);
+    }
+    REQUIRE(source.next(form) == StreamParser::END);
+  }
+
+  // editing the source invalidates the cache
+  {
+    std::ofstream ofs(path);
+    ofs << "(define a 2)";
+  }
+  {
+    CachedProgram source(path);
+    REQUIRE(!source.fromCache());
+    Expression form;
+    REQUIRE(source.next(form) == StreamParser::FORM);
+    REQUIRE(form == parse_text("(define a 2)"));
+    REQUIRE(source.next(form) == StreamParser::END);
+  }
+
+  // so does damage to the cache itself
+  {
+    std::fstream cache(path + ".cache", std::ios::in | std::ios::out | std::ios::binary);
+    cache.seekp(-1, std::ios::end);
+    cache.put('\x7f');
+  }
+  {
+    CachedProgram source(path);
+    REQUIRE(!source.fromCache());
+  }
+
+  // a program that does not parse is not cached
+  {
+    std::ofstream ofs(path);
+    ofs << "(define a 3) (define";
+  }
+  {
+    CachedProgram source(path);
+    Expression form;
+    REQUIRE(source.next(form) == StreamParser::FORM);
+    REQUIRE(source.next(form) == StreamParser::ERROR);
+  }
+  {
+    CachedProgram source(path);
+    REQUIRE(!source.fromCache());
+  }
+
+  std::remove(path.c_str());
+  std::remove((path + ".cache").c_str());
+
+  CachedProgram missing("no_such_file.pls");
+  REQUIRE(!missing.isOpen());
+  Expression form;
+  REQUIRE(missing.next(form) == StreamParser::ERROR);
+}
@@ -3,8 +3,21 @@
 #include <sstream>
 #include <cctype>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <complex>
+#include <mutex>
+#include <unordered_set>
+
+SymbolId intern(const std::string & text){
+
+  // node-based set, so the address of an element never changes
+  static std::unordered_set<std::string> table;
+  static std::mutex table_mutex;
+
+  std::lock_guard<std::mutex> lock(table_mutex);
+  return &*table.insert(text).first;
+}
 
 Atom::Atom(): m_type(NoneKind) {}
 
@@ -22,28 +35,132 @@ Atom::Atom(const std::complex<double> & value) {
 }
 
 Atom::Atom(const Token & token): Atom(){
-  
-  // is token a number?
-  double temp;
-  std::istringstream iss(token.asString());
-  if(iss >> temp){
-    // check for trailing characters if >> succeeds
-    if(iss.rdbuf()->in_avail() == 0){
-      setNumber(temp);
-	  m_type = NumberKind;
+  std::string text = token.asString();
+  setFromText(text.data(), text.size(), token.type() == Token::TokenType::QUOTE);
+}
 
+Atom::Atom(const TokenView & token, const char * buffer): Atom(){
+  setFromText(buffer + token.offset, token.length, token.type == Token::TokenType::QUOTE);
+}
+
+// powers of ten that are exact as doubles
+static const double exact_powers[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// outcome of scanning the text of a token as a number
+enum NumberScan {
+  NOT_NUMBER, // the text is not a decimal literal
+  EXACT,      // the text is a literal and value holds it, correctly rounded
+  INEXACT     // the text is a literal, but too long or large for the fast path
+};
+
+// Scans text as [+-]digits[.digits][(e|E)[+-]digits] without allocating.
+// A literal with at most 19 significant digits, a mantissa below 2^53 and a
+// decimal exponent within +-22 is converted exactly with one multiply or
+// divide, since both operands are exact doubles (Clinger's fast path).
+static NumberScan scan_number(const char * text, std::size_t length, double & value){
+  const char * c = text;
+  const char * end = text + length;
+
+  bool negative = false;
+  if(c != end && (*c == '+' || *c == '-')){
+    negative = (*c == '-');
+    ++c;
+  }
+
+  std::uint64_t mantissa = 0;
+  int digits = 0;      // significant digits in the mantissa
+  int exponent = 0;    // decimal exponent to apply to the mantissa
+  bool any = false;    // any digit before the exponent
+  bool overflow = false;
+
+  for(; c != end && *c >= '0' && *c <= '9'; ++c){
+    any = true;
+    if(mantissa == 0 && *c == '0') continue;
+    if(digits < 19) mantissa = mantissa * 10 + (*c - '0');
+    else { overflow = true; ++exponent; }
+    ++digits;
+  }
+  if(c != end && *c == '.'){
+    ++c;
+    for(; c != end && *c >= '0' && *c <= '9'; ++c){
+      any = true;
+      if(mantissa == 0 && *c == '0') { --exponent; continue; }
+      if(digits < 19) { mantissa = mantissa * 10 + (*c - '0'); --exponent; }
+      else overflow = true;
+      ++digits;
     }
   }
-  else{ // else assume symbol or string if begins with "
-	  if (token.type() == Token::TokenType::QUOTE) {
-		  setString(token.asString());
-		  m_type = StringKind;
-	  }
-    // make sure does not start with number
-    else if(!std::isdigit(token.asString()[0])){
-      setSymbol(token.asString());
-	  m_type = SymbolKind;
+  if(!any) return NOT_NUMBER;
+
+  if(c != end && (*c == 'e' || *c == 'E')){
+    ++c;
+    bool negexp = false;
+    if(c != end && (*c == '+' || *c == '-')){
+      negexp = (*c == '-');
+      ++c;
+    }
+    if(c == end || *c < '0' || *c > '9') return NOT_NUMBER;
+    int e = 0;
+    for(; c != end && *c >= '0' && *c <= '9'; ++c){
+      if(e < 100000) e = e * 10 + (*c - '0');
     }
+    exponent += negexp ? -e : e;
+  }
+  if(c != end) return NOT_NUMBER;
+
+  if(overflow || mantissa > (std::uint64_t(1) << 53)) return INEXACT;
+
+  if(mantissa == 0){
+    value = 0.0;
+  }
+  else if(exponent >= 0 && exponent <= 22){
+    value = static_cast<double>(mantissa) * exact_powers[exponent];
+  }
+  else if(exponent < 0 && exponent >= -22){
+    value = static_cast<double>(mantissa) / exact_powers[-exponent];
+  }
+  else{
+    return INEXACT;
+  }
+  if(negative) value = -value;
+
+  return EXACT;
+}
+
+void Atom::setFromText(const char * text, std::size_t length, bool quoted){
+
+  // is token a number? Nearly every literal takes the fast path
+  double temp;
+  NumberScan scan = scan_number(text, length, temp);
+  if(scan == EXACT){
+    setNumber(temp);
+    return;
+  }
+
+  if(scan == INEXACT || (length > 1 && (text[0] == '+' || text[0] == '-' || text[0] == '.'))){
+    // very long or large literals, and odd prefixes like "-5abc", get the
+    // stream's exact rules for rounding, range errors and partial matches
+    std::string str(text, length);
+    std::istringstream iss(str);
+    if(iss >> temp){
+      // check for trailing characters if >> succeeds
+      if(iss.rdbuf()->in_avail() == 0){
+        setNumber(temp);
+      }
+      return;
+    }
+  }
+
+  // else assume symbol or string if begins with "
+  if (quoted) {
+    setString(std::string(text, length));
+  }
+  // make sure does not start with number
+  else if(length == 0 || !std::isdigit(static_cast<unsigned char>(text[0]))){
+    setSymbol(std::string(text, length));
   }
 }
 
@@ -58,56 +175,53 @@ Atom::Atom(const std::string & value): Atom() {
 	}
 }
 
-Atom::Atom(const Atom & x): Atom(){
+Atom::Atom(const Atom & x) noexcept: Atom(){
   if(x.isNumber()){
     setNumber(x.numberValue);
   }
   else if(x.isSymbol()){
-    setSymbol(x.symbolValue);
+    symbolValue = x.symbolValue;
   }
   else if (x.isComplex()) {
 	  setComplex(x.complexValue);
   }
   else if (x.isString()) {
-	  setString(x.stringValue);
+	  stringValue = x.stringValue;
   }
 
   m_type = x.m_type;
+  m_slot = x.m_slot;
 }
 
-Atom & Atom::operator=(const Atom & x){
+Atom::Atom(Atom && x) noexcept: Atom(static_cast<const Atom &>(x)) {}
+
+Atom & Atom::operator=(const Atom & x) noexcept{
 
   if(this != &x){
     if(x.m_type == NumberKind){
       setNumber(x.numberValue);
     }
     else if(x.m_type == SymbolKind){
-      setSymbol(x.symbolValue);
+      symbolValue = x.symbolValue;
     }
 	else if (x.m_type == ComplexKind) {
 	  setComplex(x.complexValue);
 	}
 	else if (x.m_type == StringKind) {
-		setString(x.stringValue);
+		stringValue = x.stringValue;
 	}
 
 	m_type = x.m_type;
+	m_slot = x.m_slot;
   }
   return *this;
 }
-  
-Atom::~Atom(){
-
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    symbolValue.~basic_string();
-  }
 
-  // we need to ensure the destructor of the string string is called
-  if (m_type == StringKind) {
-	  stringValue.~basic_string();
-  }
+Atom & Atom::operator=(Atom && x) noexcept{
+  return *this = static_cast<const Atom &>(x);
 }
+  
+Atom::~Atom(){}
 
 bool Atom::isNone() const noexcept{
   return m_type == NoneKind;
@@ -143,28 +257,14 @@ void Atom::setComplex(const std::complex<double> & value) {
 
 void Atom::setSymbol(const std::string & value){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    symbolValue.~basic_string();
-  }
-    
   m_type = SymbolKind;
-
-  // copy construct in place
-  new (&symbolValue) std::string(value);
+  symbolValue = intern(value);
 }
 
 void Atom::setString(const std::string & value) {
 
-	// we need to ensure the destructor of the symbol string is called
-	if (m_type == StringKind) {
-		stringValue.~basic_string();
-	}
-
 	m_type = StringKind;
-
-	// copy construct in place
-	new (&stringValue) std::string(value);
+	stringValue = intern(value);
 }
 
 double Atom::asNumber() const noexcept{
@@ -177,26 +277,34 @@ std::complex<double> Atom::asComplex() const noexcept {
 	return (m_type == ComplexKind) ? complexValue : std::complex<double>(0.0,0.0);
 }
 
-std::string Atom::asSymbol() const noexcept{
+// shared result for asSymbol and asString on the wrong type
+static const std::string EMPTY_STRING;
 
-  std::string result;
+const std::string & Atom::asSymbol() const noexcept{
 
-  if(m_type == SymbolKind){
-    result = symbolValue;
-  }
+  return (m_type == SymbolKind) ? *symbolValue : EMPTY_STRING;
+}
+
+SymbolId Atom::asSymbolId() const noexcept{
 
-  return result;
+  if(m_type == SymbolKind) return symbolValue;
+  if(m_type == StringKind) return stringValue;
+  return nullptr;
 }
 
-std::string Atom::asString() const noexcept {
+const std::string & Atom::asString() const noexcept {
+
+	return (m_type == StringKind) ? *stringValue : EMPTY_STRING;
+}
 
-	std::string result;
+const std::uint32_t Atom::NO_SLOT;
 
-	if (m_type == StringKind) {
-		result = stringValue;
-	}
+std::uint32_t Atom::slot() const noexcept{
+  return m_slot;
+}
 
-	return result;
+void Atom::setSlot(std::uint32_t slot) noexcept{
+  m_slot = slot;
 }
 
 bool Atom::operator==(const Atom & right) const noexcept{
@@ -221,6 +329,7 @@ bool Atom::operator==(const Atom & right) const noexcept{
     {
       if(right.m_type != SymbolKind) return false;
 
+      // interned, so equal text means equal handle
       return symbolValue == right.symbolValue;
     }
     break;
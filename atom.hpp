@@ -6,6 +6,25 @@ Defines the Atom type and associated functions.
 
 #include "token.hpp"
 #include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*! \typedef SymbolId
+\brief A compact handle to an interned symbol or string.
+
+Interning the same text always yields the same handle, so handles can be
+compared and hashed as integers. The referenced text lives for the rest of
+the process.
+*/
+typedef const std::string * SymbolId;
+
+/*! \fn SymbolId intern(const std::string & text)
+\brief Get the unique handle for text, adding it to the global table if needed.
+
+Safe to call from multiple threads.
+*/
+SymbolId intern(const std::string & text);
 
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
@@ -30,11 +49,20 @@ public:
   /// Construct an Atom directly from a Token
   Atom(const Token & token);
 
+  /// Construct an Atom from a TokenView into buffer, as from the equivalent Token
+  Atom(const TokenView & token, const char * buffer);
+
   /// Copy-construct an Atom
-  Atom(const Atom & x);
+  Atom(const Atom & x) noexcept;
+
+  /// Move-construct an Atom. Atoms own no storage, so this copies x
+  Atom(Atom && x) noexcept;
 
   /// Assign an Atom
-  Atom & operator=(const Atom & x);
+  Atom & operator=(const Atom & x) noexcept;
+
+  /// Move-assign an Atom, which copies x
+  Atom & operator=(Atom && x) noexcept;
 
   /// Atom destructor
   ~Atom();
@@ -58,13 +86,28 @@ public:
   double asNumber() const noexcept;
 
   /// value of Atom as a symbol, returns empty-string if not a Symbol
-  std::string asSymbol() const noexcept;
+  const std::string & asSymbol() const noexcept;
+
+  /// interned handle of a Symbol or String Atom, nullptr for other types
+  SymbolId asSymbolId() const noexcept;
 
   /// value of Atom as a complex number, returns 0+0i if not a complex number
   std::complex<double> asComplex() const noexcept;
 
   /// value of Atom as a string, returns empty-string if not a String
-  std::string asString() const noexcept;
+  const std::string & asString() const noexcept;
+
+  /// the slot value of a Symbol with no lexical address
+  static const std::uint32_t NO_SLOT = 0xFFFFFFFF;
+
+  /*! The lexical address of a Symbol: the slot of the lambda parameter it
+    names in the frame of its enclosing lambda (see Expression::resolve), or
+    NO_SLOT. It is a hint for lookup and does not take part in comparisons.
+   */
+  std::uint32_t slot() const noexcept;
+
+  /// set the lexical address of a Symbol
+  void setSlot(std::uint32_t slot) noexcept;
 
   /// equality comparison based on type and value
   bool operator==(const Atom & right) const noexcept;
@@ -79,16 +122,23 @@ private:
   // track the type
   Type m_type;
 
-  // values for the known types. Note the use of a union requires care
-  // when setting non POD values (see setSymbol)
+  // lexical address, which fits in the padding after m_type
+  std::uint32_t m_slot = NO_SLOT;
+
+  // values for the known types. Symbols and strings are interned, so
+  // every member is POD and copying an Atom never allocates
   union {
     double numberValue;
-    std::string symbolValue;
+    SymbolId symbolValue;
 	std::complex<double> complexValue;
 
-	std::string stringValue;
+	SymbolId stringValue;
   };
 
+  // helper to set type and value from the text of a STRING or QUOTE token,
+  // leaving the Atom None if the text is not a valid literal
+  void setFromText(const char * text, std::size_t length, bool quoted);
+
   // helper to set type and value of Number
   void setNumber(double value);
 
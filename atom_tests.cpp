@@ -2,6 +2,26 @@
 
 #include "atom.hpp"
 
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// the Atom the original istringstream classifier made for text
+static Atom stream_atom(const std::string & text){
+  double value;
+  std::istringstream iss(text);
+  if(iss >> value){
+    return (iss.rdbuf()->in_avail() == 0) ? Atom(value) : Atom();
+  }
+  if(text[0] == '"') return Atom(text);
+  if(std::isdigit(static_cast<unsigned char>(text[0]))) return Atom();
+  return Atom(text);
+}
+
 TEST_CASE( "Test constructors", "[atom]" ) {
 
   {
@@ -232,3 +252,94 @@ TEST_CASE( "test comparison", "[atom]" ) {
 
 
 
+
+TEST_CASE( "Test symbol interning", "[atom]" ) {
+
+  SymbolId a = intern("foo");
+  SymbolId b = intern(std::string("fo") + "o");
+  REQUIRE(a == b);
+  REQUIRE(*a == "foo");
+  REQUIRE(a != intern("bar"));
+
+  Atom sym("foo");
+  Atom str("\"foo\"");
+  REQUIRE(sym.asSymbolId() == a);
+  REQUIRE(str.asSymbolId() == intern("\"foo\""));
+  REQUIRE(sym != str);
+  REQUIRE(Atom(1.0).asSymbolId() == nullptr);
+
+  Atom copy = sym;
+  REQUIRE(copy.asSymbolId() == sym.asSymbolId());
+  REQUIRE(copy.asSymbol() == "foo");
+}
+
+TEST_CASE( "Test number literals from tokens", "[atom]" ) {
+
+  std::vector<std::string> literals = {
+    "0", "-0", "1", "+1", "-1", "3.14159", ".5", "-.5", "5.", "1e3", "1E-3", "2.5e+10",
+    "0.1", "0.30000000000000004", "123456789012345678", "12345678901234567890123",
+    "9007199254740993", "1e22", "1e23", "1e-22", "1e-320", "1.7976931348623157e308",
+    "1e400", "-1e400", "00012", "0.000001",
+    "1.2abc", "-5abc", "1.2.3", "1e", "1e+", "-5e+", "0x10", "-", "+", ".", "-.", "-x",
+    "abc", "e5", "inf", "-inf", "\"12\"", "\"text\""
+  };
+
+  for(auto & text : literals){
+    INFO(text);
+    Token::TokenType type = (text[0] == '"') ? Token::QUOTE : Token::STRING;
+    TokenView view = {type, 0, text.size()};
+    Atom expected = stream_atom(text);
+    REQUIRE(Atom(Token(text)) == expected);
+    REQUIRE(Atom(view, text.data()) == expected);
+    if(expected.isNumber()){
+      REQUIRE(std::signbit(Atom(Token(text)).asNumber()) == std::signbit(expected.asNumber()));
+    }
+  }
+
+  // random literals must round exactly as the stream does
+  std::mt19937_64 gen(3574);
+  std::uniform_real_distribution<double> magnitude(-30, 30);
+  std::uniform_int_distribution<int> precision(1, 20);
+  for(int i = 0; i < 20000; ++i){
+    std::ostringstream oss;
+    oss.precision(precision(gen));
+    oss << std::pow(10.0, magnitude(gen)) * ((i % 2) ? -1 : 1);
+    std::string text = oss.str();
+    INFO(text);
+    REQUIRE(Atom(Token(text)) == stream_atom(text));
+  }
+}
+
+TEST_CASE( "Benchmark number literal parsing", "[.][benchmark]" ) {
+
+  // a numeric-heavy input, as in large list data files
+  const std::size_t count = 10000000;
+  std::string input;
+  std::mt19937_64 gen(3574);
+  std::uniform_real_distribution<double> values(-1000, 1000);
+  for(std::size_t i = 0; i < count; ++i){
+    std::ostringstream oss;
+    oss << values(gen) << ' ';
+    input += oss.str();
+  }
+  TokenViewSequenceType tokens = tokenize(input.data(), input.size());
+  REQUIRE(tokens.size() == count);
+
+  auto start = std::chrono::steady_clock::now();
+  double before = 0;
+  for(auto & token : tokens){
+    before += stream_atom(token.asString(input.data())).asNumber();
+  }
+  auto middle = std::chrono::steady_clock::now();
+  double after = 0;
+  for(auto & token : tokens){
+    after += Atom(token, input.data()).asNumber();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  REQUIRE(before == after);
+  double stream_rate = count / std::chrono::duration<double>(middle - start).count();
+  double fast_rate = count / std::chrono::duration<double>(end - middle).count();
+  std::cout << "number literals per second: istringstream " << stream_rate
+            << ", Atom(TokenView) " << fast_rate << std::endl;
+}
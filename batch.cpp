@@ -0,0 +1,120 @@
+#include "batch.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "ast_cache.hpp"
+#include "ring_queue.hpp"
+#include "semantic_error.hpp"
+
+// scripts queued per kernel before run_batch waits for results
+static const std::size_t WINDOW_PER_KERNEL = 64;
+
+KernelPool::Result evaluate_script(Interpreter & interp, const std::string & path, Interrupt * interrupt){
+
+  KernelPool::Result result;
+  CachedProgram program(path);
+
+  if(!program.isOpen()){
+    result.first = "Error: Could not open file for reading.";
+    return result;
+  }
+
+  if(interrupt) interrupt->start();
+
+  bool empty = true;
+  while(true){
+    StreamParser::Status status = interp.parseNext(program);
+    if(status == StreamParser::END && !empty) break;
+    if(status != StreamParser::FORM){
+      result.first = "Error: Invalid Program. Could not parse.";
+      return result;
+    }
+    empty = false;
+
+    try{
+      result.second = interp.evaluate();
+    }
+    catch(const SemanticError & ex){
+      result.first = ex.what();
+      return result;
+    }
+  }
+
+  return result;
+}
+
+std::vector<std::string> read_manifest(std::istream & manifest){
+
+  std::vector<std::string> paths;
+  std::string line;
+  const char * space = " \t\r\n";
+
+  while(std::getline(manifest, line)){
+    std::size_t first = line.find_first_not_of(space);
+    if(first == std::string::npos || line[first] == '#') continue;
+    std::size_t last = line.find_last_not_of(space);
+    paths.push_back(line.substr(first, last - first + 1));
+  }
+  return paths;
+}
+
+std::size_t run_batch(KernelPool & pool, const std::vector<std::string> & paths, std::ostream & out){
+
+  typedef std::chrono::steady_clock Clock;
+
+  // the index of a finished script and its result; never fills, since no
+  // more than window scripts are outstanding. Callbacks share it, as one may
+  // still be returning from its push after the last result is written
+  typedef std::pair<std::size_t, KernelPool::Result> Finished;
+  std::size_t window = pool.metrics().kernels * WINDOW_PER_KERNEL;
+  std::shared_ptr<RingQueue<Finished>> finished = std::make_shared<RingQueue<Finished>>(window);
+
+  // each script's evaluation time, written by its kernel before its result is pushed
+  std::shared_ptr<std::vector<double>> times = std::make_shared<std::vector<double>>(paths.size());
+
+  std::size_t submitted = 0;
+  std::size_t written = 0;
+  std::size_t failed = 0;
+
+  while(written < paths.size()){
+
+    while(submitted < paths.size() && submitted - written < window){
+      std::size_t index = submitted++;
+      const std::string & path = paths[index];
+      pool.submit_any(
+        [path, index, times](Interpreter & interp, Interrupt * interrupt){
+          Clock::time_point start = Clock::now();
+          KernelPool::Result result = evaluate_script(interp, path, interrupt);
+          (*times)[index] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+          return result;
+        },
+        [finished, index](KernelPool::Result && result){
+          finished->push(Finished(index, std::move(result)));
+        });
+    }
+
+    Finished done;
+    finished->wait_and_pop(done);
+    written++;
+
+    std::ostringstream time;
+    time << std::fixed << std::setprecision(3) << (*times)[done.first];
+
+    out << paths[done.first] << '\t' << (done.second.first.empty() ? "ok" : "error") << '\t'
+        << time.str() << '\t';
+    if(done.second.first.empty()){
+      out << done.second.second;
+    }
+    else{
+      out << done.second.first;
+      failed++;
+    }
+    out << std::endl;
+  }
+
+  return failed;
+}
@@ -0,0 +1,46 @@
+/*! \file batch.hpp
+Defines the batch runner that evaluates many script files across a kernel
+pool, as plotscript --batch does.
+ */
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "interrupt.hpp"
+#include "kernel_pool.hpp"
+
+/*! Evaluate the script file at path form by form in interp, as plotscript
+  <file> does, reading its AST cache when that is current.
+  \param interp the interpreter, whose environment the script defines into
+  \param path the script file
+  \param interrupt started once for the whole script, or nullptr
+  \return the error message (empty on success) and the value of the last form
+ */
+KernelPool::Result evaluate_script(Interpreter & interp, const std::string & path, Interrupt * interrupt);
+
+/*! Read a manifest of script paths, one per line. Blank lines and lines
+  starting with # are skipped, as is whitespace around each path.
+ */
+std::vector<std::string> read_manifest(std::istream & manifest);
+
+/*! Evaluate every script in paths on pool, each in a fresh environment
+  forked from the pool's snapshot, and write one line per script to out as
+  soon as it finishes:
+
+      <path> TAB ok TAB <milliseconds> TAB <value>
+      <path> TAB error TAB <milliseconds> TAB <message>
+
+  Lines come in the order the scripts finish, and the time is the script's
+  own evaluation, not its wait in the queue. Only a bounded number of
+  scripts are queued at once, so the list may be any length.
+  \return the number of scripts that failed
+ */
+std::size_t run_batch(KernelPool & pool, const std::vector<std::string> & paths, std::ostream & out);
+
+#endif
@@ -0,0 +1,128 @@
+#include "catch.hpp"
+
+#include "batch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// write a script, removing any cache left from an earlier run
+static void write_script(const std::string & path, const std::string & program){
+  std::remove((path + ".cache").c_str());
+  std::ofstream ofs(path);
+  ofs << program;
+}
+
+static void remove_script(const std::string & path){
+  std::remove(path.c_str());
+  std::remove((path + ".cache").c_str());
+}
+
+TEST_CASE( "Test reading a batch manifest", "[batch]" ) {
+
+  std::istringstream manifest("a.pls\n\n  # skipped\n\tb.pls  \r\nc d.pls\n");
+  std::vector<std::string> paths = read_manifest(manifest);
+
+  REQUIRE(paths.size() == 3);
+  REQUIRE(paths[0] == "a.pls");
+  REQUIRE(paths[1] == "b.pls");
+  REQUIRE(paths[2] == "c d.pls");
+}
+
+TEST_CASE( "Test evaluating a script file", "[batch]" ) {
+
+  std::string path = "batch_test_script.pls";
+  write_script(path, "(define a 1)\n(define b (+ a 1))\n(* a b 10)\n");
+
+  {
+    Interpreter interp;
+    KernelPool::Result result = evaluate_script(interp, path, nullptr);
+    REQUIRE(result.first.empty());
+    REQUIRE(result.second == Expression(20.0));
+  }
+
+  write_script(path, "(define a 1)\n(+ a b)\n(define c 3)\n");
+  {
+    Interpreter interp;
+    KernelPool::Result result = evaluate_script(interp, path, nullptr);
+    REQUIRE(result.first.find("Error") == 0);
+  }
+
+  write_script(path, "(define a 1))");
+  {
+    Interpreter interp;
+    KernelPool::Result result = evaluate_script(interp, path, nullptr);
+    REQUIRE(result.first == "Error: Invalid Program. Could not parse.");
+  }
+
+  remove_script(path);
+
+  Interpreter interp;
+  REQUIRE(evaluate_script(interp, "no_such_file.pls", nullptr).first == "Error: Could not open file for reading.");
+}
+
+TEST_CASE( "Test running a batch of scripts", "[batch]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 2);
+
+  // every script defines the same symbol, so each needs an environment of its own
+  std::vector<std::string> paths;
+  for(int i = 0; i < 200; ++i){
+    std::string path = "batch_test_" + std::to_string(i) + ".pls";
+    if(i % 50 == 7){
+      write_script(path, "(define x 1)\n(+ x undefined)\n");
+    }
+    else{
+      write_script(path, "(define x " + std::to_string(i) + ")\n(+ x 1)\n");
+    }
+    paths.push_back(path);
+  }
+  paths.push_back("no_such_file.pls");
+
+  std::ostringstream out;
+  REQUIRE(run_batch(pool, paths, out) == 5);
+
+  // one line per script: path, status, milliseconds and the value or error
+  std::istringstream lines(out.str());
+  std::string line;
+  std::vector<bool> seen(paths.size(), false);
+  std::size_t count = 0;
+  while(std::getline(lines, line)){
+    count++;
+    std::istringstream fields(line);
+    std::string path, status, time, value;
+    std::getline(fields, path, '\t');
+    std::getline(fields, status, '\t');
+    std::getline(fields, time, '\t');
+    std::getline(fields, value);
+
+    std::size_t index = paths.size() - 1;
+    if(path != "no_such_file.pls"){
+      index = std::stoul(path.substr(11));
+    }
+    REQUIRE(paths[index] == path);
+    REQUIRE(!seen[index]);
+    seen[index] = true;
+
+    REQUIRE(std::stod(time) >= 0);
+    if(index == paths.size() - 1 || index % 50 == 7){
+      REQUIRE(status == "error");
+      REQUIRE(value.find("Error") == 0);
+    }
+    else{
+      REQUIRE(status == "ok");
+      REQUIRE(value == "(" + std::to_string(index + 1) + ")");
+    }
+  }
+  REQUIRE(count == paths.size());
+
+  for(std::size_t i = 0; i + 1 < paths.size(); ++i){
+    remove_script(paths[i]);
+  }
+
+  std::ostringstream none;
+  REQUIRE(run_batch(pool, std::vector<std::string>(), none) == 0);
+  REQUIRE(none.str().empty());
+}
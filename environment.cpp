@@ -1,15 +1,20 @@
 #include "environment.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <complex>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <iomanip>
+#include <iterator>
 
 
 #include "environment.hpp"
+#include "kernels.hpp"
 #include "semantic_error.hpp"
+#include "thread_pool.hpp"
 
 /*********************************************************************** 
 Helper Functions
@@ -20,49 +25,231 @@ bool nargs_equal(const std::vector<Expression> & args, unsigned nargs){
   return args.size() == nargs;
 }
 
+// interned property keys of the graphics objects built by the plot procedures
+static const SymbolId OBJECT_NAME_KEY = intern("\"object-name\"");
+static const SymbolId SIZE_KEY = intern("\"size\"");
+static const SymbolId THICKNESS_KEY = intern("\"thickness\"");
+static const SymbolId POSITION_KEY = intern("\"position\"");
+static const SymbolId TEXT_SCALE_KEY = intern("\"text-scale\"");
+static const SymbolId TEXT_ROTATION_KEY = intern("\"text-rotation\"");
+
+/*********************************************************************** 
+Broadcasting helpers. When an arithmetic procedure gets a list argument it
+applies elementwise: lists must have the same length and every other
+argument is reused for each element. Packed lists of Numbers go through
+the vector kernels, anything else through the scalar procedure.
+**********************************************************************/
+
+// predicate, some argument is a list
+static bool has_list_arg(const std::vector<Expression> & args){
+  for (auto & a : args) {
+    if (a.isHeadList()) return true;
+  }
+  return false;
+}
+
+// the common length of the list arguments
+static std::size_t broadcast_length(const std::vector<Expression> & args, const std::string & name){
+  bool found = false;
+  std::size_t n = 0;
+  for (auto & a : args) {
+    if (!a.isHeadList()) continue;
+    if (!found) {
+      n = a.tailLength();
+      found = true;
+    }
+    else if (a.tailLength() != n) {
+      throw SemanticError("Error in call to " + name + ": list arguments differ in length.");
+    }
+  }
+  return n;
+}
+
+// element i of a list argument, or the argument itself
+static Expression broadcast_element(const Expression & a, std::size_t i){
+  if (!a.isHeadList()) return a;
+  if (const PackedTail * p = a.packed()) {
+    return p->complex ? Expression(p->complexes[i]) : Expression(p->numbers[i]);
+  }
+  return a.getTail()[i];
+}
+
+// apply the scalar procedure proc elementwise, one call per element
+static Expression broadcast(const std::vector<Expression> & args, Procedure proc, const std::string & name){
+  std::size_t n = broadcast_length(args, name);
+  std::vector<Expression> results;
+  results.reserve(n);
+  std::vector<Expression> elementArgs;
+  for (std::size_t i = 0; i < n; i++) {
+    // proc owns its arguments, so they are set up afresh for each element
+    elementArgs.clear();
+    for (std::size_t j = 0; j < args.size(); j++) {
+      elementArgs.push_back(broadcast_element(args[j], i));
+    }
+    results.push_back(proc(elementArgs));
+  }
+  return Expression::makeList(std::move(results));
+}
+
+// predicate, every list argument is packed and every other argument is a
+// Number or Complex. complex is set if any of the values are Complex
+static bool packed_args(const std::vector<Expression> & args, bool & complex){
+  complex = false;
+  for (auto & a : args) {
+    if (a.isHeadList()) {
+      const PackedTail * p = a.packed();
+      if (p == nullptr) return false;
+      complex = complex || p->complex;
+    }
+    else if (a.isHeadComplex()) {
+      complex = true;
+    }
+    else if (!a.isHeadNumber()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// acc = acc op value, as the scalar procedures compute it
+template <typename T>
+static void combine(KernelOp op, std::complex<double> & acc, const T & value){
+  switch (op) {
+  case KERNEL_ADD: acc += value; break;
+  case KERNEL_SUB: acc -= value; break;
+  case KERNEL_MUL: acc *= value; break;
+  case KERNEL_DIV: acc /= value; break;
+  }
+}
+
+// fold args[first..] into init with op, elementwise over n values, where
+// packed_args holds for init and args
+static Expression fold_packed(const Expression & init, const std::vector<Expression> & args, std::size_t first,
+                              KernelOp op, std::size_t n, bool complex){
+  if (!complex) {
+    std::vector<double> acc;
+    if (init.isHeadList()) acc = init.packed()->numbers;
+    else acc.assign(n, init.head().asNumber());
+
+    for (std::size_t j = first; j < args.size(); j++) {
+      if (args[j].isHeadList()) kernel_vv(op, acc.data(), args[j].packed()->numbers.data(), acc.data(), n);
+      else kernel_vs(op, acc.data(), args[j].head().asNumber(), acc.data(), n);
+    }
+    return Expression(std::move(acc));
+  }
+
+  std::vector<std::complex<double>> acc;
+  if (init.isHeadList() && init.packed()->complex) acc = init.packed()->complexes;
+  else if (init.isHeadList()) acc.assign(init.packed()->numbers.begin(), init.packed()->numbers.end());
+  else if (init.isHeadComplex()) acc.assign(n, init.head().asComplex());
+  else acc.assign(n, std::complex<double>(init.head().asNumber(), 0.0));
+
+  // complex<double> is laid out as two doubles, so some operations reduce
+  // to the real kernels over 2n values
+  double * flat = reinterpret_cast<double *>(acc.data());
+  for (std::size_t j = first; j < args.size(); j++) {
+    const Expression & a = args[j];
+    const PackedTail * p = a.packed();
+    if (p && p->complex && (op == KERNEL_ADD || op == KERNEL_SUB)) {
+      kernel_vv(op, flat, reinterpret_cast<const double *>(p->complexes.data()), flat, 2 * n);
+    }
+    else if (a.isHeadNumber() && (op == KERNEL_MUL || op == KERNEL_DIV)) {
+      kernel_vs(op, flat, a.head().asNumber(), flat, 2 * n);
+    }
+    else if (p && p->complex) {
+      for (std::size_t i = 0; i < n; i++) combine(op, acc[i], p->complexes[i]);
+    }
+    else if (p) {
+      for (std::size_t i = 0; i < n; i++) combine(op, acc[i], p->numbers[i]);
+    }
+    else if (a.isHeadComplex()) {
+      for (std::size_t i = 0; i < n; i++) combine(op, acc[i], a.head().asComplex());
+    }
+    else {
+      for (std::size_t i = 0; i < n; i++) combine(op, acc[i], a.head().asNumber());
+    }
+  }
+  return Expression(std::move(acc));
+}
+
+// broadcast an arithmetic procedure: fold args[first..] into init with op,
+// falling back to proc per element when the arguments are not packed
+static Expression broadcast_arithmetic(const Expression & init, const std::vector<Expression> & args, std::size_t first,
+                                       KernelOp op, Procedure proc, const std::string & name){
+  std::size_t n = broadcast_length(args, name);
+  bool complex = false;
+  if (!packed_args(args, complex)) {
+    return broadcast(args, proc, name);
+  }
+  complex = complex || init.isHeadComplex();
+  return fold_packed(init, args, first, op, n, complex);
+}
+
+// apply f to each value of a packed list of Numbers
+static Expression map_numbers(const PackedTail & p, double (*f)(double)){
+  std::vector<double> values(p.numbers.size());
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = f(p.numbers[i]);
+  }
+  return Expression(std::move(values));
+}
+
+// predicate, a is a packed list of Numbers all greater than (or equal to,
+// if orEqual) zero
+static bool packed_positive(const Expression & a, bool orEqual){
+  const PackedTail * p = a.packed();
+  if (p == nullptr || p->complex) return false;
+  for (double x : p->numbers) {
+    if (!(x > 0 || (orEqual && x == 0))) return false;
+  }
+  return true;
+}
+
 /*********************************************************************** 
 Each of the functions below have the signature that corresponds to the
 typedef'd Procedure function pointer.
 **********************************************************************/
 
 // the default procedure always returns an expresison of type None
-Expression default_proc(const std::vector<Expression> & args){
+Expression default_proc(std::vector<Expression> & args){
   args.size(); // make compiler happy we used this parameter
   return Expression();
 };
 
 // the default binary procedure always returns an expresison of type None
-Expression default_proc_bi(const std::vector<Expression> & args, Environment & env) {
+Expression default_proc_bi(std::vector<Expression> & args, Environment & env) {
 	args.size(); // make compiler happy we used this parameter
 	env.reset();
 	return Expression();
 };
 
-// the default procedure_prop always returns an expresison of type None
-Expression default_proc_prop(std::vector<Expression> & args) {
-	args.size(); // make compiler happy we used this parameter
-	return Expression();
-};
-
-Environment::Environment(const Environment & env) {
-	envmap = env.envmap;
+// a copy of a scope frame is allocated like any other scope frame, and a
+// copy of anything else, such as a snapshot, on the heap
+Environment::Environment(const Environment & env):
+  locals(env.locals.begin(), env.locals.end(),
+         ArenaAllocator<Local>((env.parent != nullptr && !env.base) ? Arena::current() : nullptr)) {
+	bindings = env.bindings;
+	parent = env.parent;
+	base = env.base;
+	interrupt = env.interrupt;
 }
 
 //Procedure to create a list as a vector of expressions
-Expression list(const std::vector<Expression> & args) {
-	return Expression(args);
+Expression list(std::vector<Expression> & args) {
+	return Expression::makeList(std::move(args));
 };
 
 //Procedure to return the first item of a list.
 //Throws a semantic error for arguments not being a list, more than 1 argument, or an empty list
-Expression first(const std::vector<Expression> & args) {
-	std::vector<Expression> emptyVector;
+Expression first(std::vector<Expression> & args) {
 
 	if (nargs_equal(args, 1)) {
-		if (args[0].head() == Atom("list")) {
-			if (args[0] != Expression(emptyVector)) {
-				std::vector<Expression> tail = args[0].getTail();
-				return Expression(tail[0]);
+		if (args[0].isHeadList()) {
+			if (args[0].tailLength() != 0) {
+				if (const PackedTail * packed = args[0].packed()) {
+					return packed->complex ? Expression(packed->complexes[0]) : Expression(packed->numbers[0]);
+				}
+				return args[0].getTail()[0];
 			}
 			else {
 				throw SemanticError("Error in call to first, argument is an empty list");
@@ -79,19 +266,25 @@ Expression first(const std::vector<Expression> & args) {
 
 //Procedure to return the second-last items in a list.
 //Throws a semantic error for arguments not being a list, more than 1 argument, or an empty list
-Expression rest(const std::vector<Expression> & args) {
-	std::vector<Expression> emptyVector, returnVector;
+Expression rest(std::vector<Expression> & args) {
+	std::vector<Expression> returnVector;
 
 	if (nargs_equal(args, 1)) {
-		if (args[0].head() == Atom("list")) {
-			if (args[0] != Expression(emptyVector)) {
+		if (args[0].isHeadList()) {
+			if (args[0].tailLength() != 0) {
+				if (const PackedTail * packed = args[0].packed()) {
+					if (packed->complex) {
+						return Expression(std::vector<std::complex<double>>(packed->complexes.begin() + 1, packed->complexes.end()));
+					}
+					return Expression(std::vector<double>(packed->numbers.begin() + 1, packed->numbers.end()));
+				}
 				//iterate through the vector and push back each expression onto the return vector except for the first item
 				for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
 					if (e != args[0].tailConstBegin()) {
 						returnVector.push_back(*e);
 					}
 				}
-				return Expression(returnVector);
+				return Expression(std::move(returnVector));
 			}
 			else {
 				throw SemanticError("Error in call to rest, argument is an empty list");
@@ -108,11 +301,10 @@ Expression rest(const std::vector<Expression> & args) {
 
 //Procedure to return the length of a list
 //Throws a semantic error for arguments not being a list, more than 1 argument
-Expression length(const std::vector<Expression> & args) {
-	std::vector<Expression> emptyVector;
+Expression length(std::vector<Expression> & args) {
 
 	if (nargs_equal(args, 1)) {
-		if (args[0].head() == Atom("list")) {
+		if (args[0].isHeadList()) {
 				return Expression(args[0].tailLength());
 		}
 		else {
@@ -126,15 +318,18 @@ Expression length(const std::vector<Expression> & args) {
 
 //Procedure to append an expression onto another
 //Throws a semantic error for first argument not being a list, or not having binary arguments
-Expression append(const std::vector<Expression> & args) {
-	std::vector<Expression> retVector;
+Expression append(std::vector<Expression> & args) {
 
 	if (nargs_equal(args, 2)) {
-		if (args[0].head() == Atom("list")) {
-			for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
-				retVector.push_back(*e);
-			}
-			retVector.push_back(args[1]);
+		if (args[0].isHeadList()) {
+			// the list is taken from args, so appending only copies it if it
+			// is shared, as when it is also bound to a symbol
+			Expression ret = std::move(args[0]);
+			// the result is a new list, without the properties of the old one
+			ret.setPropertyList(PropertyList());
+			// Expression::append keeps a packed list packed when it can
+			ret.append(std::move(args[1]));
+			return ret;
 		}
 		else {
 			throw SemanticError("Error in call to append, argument 1 not a list");
@@ -143,23 +338,31 @@ Expression append(const std::vector<Expression> & args) {
 	else {
 		throw SemanticError("Error in call to append, need 2 arguments");
 	}
-
-	return Expression(retVector);
 };
 
 //Procedure to join a list onto another
 //Throws a semantic error for not binary args or not two lists
-Expression join(const std::vector<Expression> & args) {
+Expression join(std::vector<Expression> & args) {
 	std::vector<Expression> retVector;
 
 	if (nargs_equal(args, 2)) {
-		if (args[0].head() == Atom("list") && args[1].head() == Atom("list")) {
-			for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
-				retVector.push_back(*e);
-			}
-			for (auto e = args[1].tailConstBegin(); e != args[1].tailConstEnd(); ++e) {
-				retVector.push_back(*e);
+		if (args[0].isHeadList() && args[1].isHeadList()) {
+			const PackedTail * left = args[0].packed();
+			const PackedTail * right = args[1].packed();
+			if (left && right && (left->complex == right->complex)) {
+				if (left->complex) {
+					std::vector<std::complex<double>> values(left->complexes);
+					values.insert(values.end(), right->complexes.begin(), right->complexes.end());
+					return Expression(std::move(values));
+				}
+				std::vector<double> values(left->numbers);
+				values.insert(values.end(), right->numbers.begin(), right->numbers.end());
+				return Expression(std::move(values));
 			}
+			//otherwise join the elements, unpacking whichever list is packed
+			retVector = args[0].unpackTail();
+			std::vector<Expression> right_elements = args[1].unpackTail();
+			std::move(right_elements.begin(), right_elements.end(), std::back_inserter(retVector));
 		}
 		else {
 			throw SemanticError("Error in call to join, argument 1 or 2 not a list");
@@ -169,14 +372,14 @@ Expression join(const std::vector<Expression> & args) {
 		throw SemanticError("Error in call to join, need 2 arguments");
 	}
 
-	return Expression(retVector);
+	return Expression(std::move(retVector));
 };
 
 
 //Procedure to create a list from the first argument to the second arg with an increment of the third arg
 //Throws a semantic error for not 3 args, any args not a number, first not less than second, or negative increment
-Expression range(const std::vector<Expression> & args) {
-	std::vector<Expression> returnVector;
+Expression range(std::vector<Expression> & args) {
+	std::vector<double> returnVector;
 
 	if (nargs_equal(args, 3)) {
 		if (args[0].isHeadNumber() && args[1].isHeadNumber() && args[2].isHeadNumber()) {
@@ -187,7 +390,7 @@ Expression range(const std::vector<Expression> & args) {
 					double increment = args[2].head().asNumber();
 					double i = begin;
 					while (i <= end) {
-						returnVector.push_back(Expression(i));
+						returnVector.push_back(i);
 						i = i + increment;
 					}
 				}
@@ -207,10 +410,14 @@ Expression range(const std::vector<Expression> & args) {
 		throw SemanticError("Error in call to range, need 3 arguments");
 	}
 
-	return Expression(returnVector);
+	return Expression(std::move(returnVector));
 };
 
-Expression add(const std::vector<Expression> & args){
+Expression add(std::vector<Expression> & args){
+  if (has_list_arg(args)) {
+    return broadcast_arithmetic(Expression(0.0), args, 0, KERNEL_ADD, add, "add");
+  }
+
   // check all aruments are numbers, while adding
   double realResult = 0;
   std::complex<double> complexResult(0.0,0.0);
@@ -245,7 +452,11 @@ Expression add(const std::vector<Expression> & args){
 
 };
 
-Expression mul(const std::vector<Expression> & args){
+Expression mul(std::vector<Expression> & args){
+	if (has_list_arg(args)) {
+		return broadcast_arithmetic(Expression(1.0), args, 0, KERNEL_MUL, mul, "multiply");
+	}
+
  
   // check all aruments are numbers, while multiplying
 	double realResult = 1;
@@ -278,7 +489,19 @@ Expression mul(const std::vector<Expression> & args){
 	return (complexFlag ? Expression(complexResult) : Expression(realResult));
 };
 
-Expression subneg(const std::vector<Expression> & args){
+Expression subneg(std::vector<Expression> & args){
+  if (has_list_arg(args)) {
+    bool complex = false;
+    // negation is multiplication by -1, which is exact
+    if (nargs_equal(args, 1) && packed_args(args, complex)) {
+      return fold_packed(Expression(-1.0), args, 0, KERNEL_MUL, args[0].tailLength(), complex);
+    }
+    if (nargs_equal(args, 2)) {
+      return broadcast_arithmetic(args[0], args, 1, KERNEL_SUB, subneg, "subtraction");
+    }
+    return broadcast(args, subneg, "subtraction or negation");
+  }
+
 
   double realResult = 0;
   std::complex<double> complexResult(0.0, 0.0);
@@ -327,7 +550,17 @@ Expression subneg(const std::vector<Expression> & args){
   return (complexFlag ? Expression(complexResult) : Expression(realResult));
 };
 
-Expression div(const std::vector<Expression> & args){
+Expression div(std::vector<Expression> & args){
+  if (has_list_arg(args)) {
+    if (nargs_equal(args, 1)) {
+      return broadcast_arithmetic(Expression(1.0), args, 0, KERNEL_DIV, div, "division");
+    }
+    if (nargs_equal(args, 2)) {
+      return broadcast_arithmetic(args[0], args, 1, KERNEL_DIV, div, "division");
+    }
+    return broadcast(args, div, "division");
+  }
+
 
   double realResult = 0;  
   std::complex<double> complexResult(0.0, 0.0);
@@ -371,7 +604,17 @@ Expression div(const std::vector<Expression> & args){
   return (complexFlag ? Expression(complexResult) : Expression(realResult));
 };
 
-Expression sqrt(const std::vector<Expression> & args) {
+Expression sqrt(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		if (nargs_equal(args, 1) && packed_positive(args[0], true)) {
+			const std::vector<double> & values = args[0].packed()->numbers;
+			std::vector<double> roots(values.size());
+			kernel_sqrt(values.data(), roots.data(), values.size());
+			return Expression(std::move(roots));
+		}
+		return broadcast(args, sqrt, "sqrt");
+	}
+
 
 	double realResult = 0;
 	std::complex<double> complexResult(0.0,0.0);
@@ -406,7 +649,23 @@ Expression sqrt(const std::vector<Expression> & args) {
 /*Function that takes the first argument to the power of the second.
   If one argument or both are complex, return it as complex.
   */
-Expression pow(const std::vector<Expression> & args) {
+Expression pow(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		bool complex = false;
+		if (nargs_equal(args, 2) && packed_args(args, complex) && !complex) {
+			std::size_t n = broadcast_length(args, "pow");
+			const PackedTail * base = args[0].packed();
+			const PackedTail * exponent = args[1].packed();
+			std::vector<double> values(n);
+			for (std::size_t i = 0; i < n; i++) {
+				values[i] = std::pow(base ? base->numbers[i] : args[0].head().asNumber(),
+				                     exponent ? exponent->numbers[i] : args[1].head().asNumber());
+			}
+			return Expression(std::move(values));
+		}
+		return broadcast(args, pow, "pow");
+	}
+
 
 	double realResult = 0;
 	std::complex<double> complexResult(0.0, 0.0);
@@ -441,7 +700,14 @@ Expression pow(const std::vector<Expression> & args) {
 /*Function that returns the natural log of an argument.
   Throws an error for invalid number of arguments or an arg less than or equal to 0
   */
-Expression ln(const std::vector<Expression> & args) {
+Expression ln(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		if (nargs_equal(args, 1) && packed_positive(args[0], false)) {
+			return map_numbers(*args[0].packed(), [](double x) { return std::log(x); });
+		}
+		return broadcast(args, ln, "ln");
+	}
+
 
 	double result = 0;
 
@@ -461,7 +727,14 @@ Expression ln(const std::vector<Expression> & args) {
 
 /*Function that returns the sin of a real number
 */
-Expression sin(const std::vector<Expression> & args) {
+Expression sin(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		if (nargs_equal(args, 1) && args[0].packed() && !args[0].packed()->complex) {
+			return map_numbers(*args[0].packed(), [](double x) { return std::sin(x); });
+		}
+		return broadcast(args, sin, "sin");
+	}
+
 
 	double result = 0;
 
@@ -481,7 +754,14 @@ Expression sin(const std::vector<Expression> & args) {
 
 /*Function that returns the cos of a real number
 */
-Expression cos(const std::vector<Expression> & args) {
+Expression cos(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		if (nargs_equal(args, 1) && args[0].packed() && !args[0].packed()->complex) {
+			return map_numbers(*args[0].packed(), [](double x) { return std::cos(x); });
+		}
+		return broadcast(args, cos, "cos");
+	}
+
 
 	double result = 0;
 
@@ -501,7 +781,14 @@ Expression cos(const std::vector<Expression> & args) {
 
 /*Function that returns the tan of a real number
 */
-Expression tan(const std::vector<Expression> & args) {
+Expression tan(std::vector<Expression> & args) {
+	if (has_list_arg(args)) {
+		if (nargs_equal(args, 1) && args[0].packed() && !args[0].packed()->complex) {
+			return map_numbers(*args[0].packed(), [](double x) { return std::tan(x); });
+		}
+		return broadcast(args, tan, "tan");
+	}
+
 
 	double result = 0;
 
@@ -520,7 +807,7 @@ Expression tan(const std::vector<Expression> & args) {
 };
 
 /*Function that returns the real part of a complex number*/
-Expression real(const std::vector<Expression> & args) {
+Expression real(std::vector<Expression> & args) {
 
 	double result = 0;
 
@@ -539,7 +826,7 @@ Expression real(const std::vector<Expression> & args) {
 };
 
 /*Function that returns the imaginary part of a complex number*/
-Expression imag(const std::vector<Expression> & args) {
+Expression imag(std::vector<Expression> & args) {
 
 	double result = 0;
 
@@ -558,7 +845,7 @@ Expression imag(const std::vector<Expression> & args) {
 };
 
 /*Function that returns the magnitude of a complex number*/
-Expression mag(const std::vector<Expression> & args) {
+Expression mag(std::vector<Expression> & args) {
 
 	double result = 0;
 
@@ -576,7 +863,7 @@ Expression mag(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
-Expression arg(const std::vector<Expression> & args) {
+Expression arg(std::vector<Expression> & args) {
 
 	double result = 0;
 
@@ -594,7 +881,7 @@ Expression arg(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
-Expression conj(const std::vector<Expression> & args) {
+Expression conj(std::vector<Expression> & args) {
 
 	std::complex<double> result(0.0,0.0);
 
@@ -617,10 +904,10 @@ Expression makeLineFromPoints(const Expression& point1, const Expression& point2
 	const Expression THICKNESS(0);
 	const Expression LINE(Atom("\"line\""));
 
-	double point1x = point1.getTail().at(0).head().asNumber()*xscale;
-	double point1y = -point1.getTail().at(1).head().asNumber()*yscale;
-	double point2x = point2.getTail().at(0).head().asNumber()*xscale;
-	double point2y = -point2.getTail().at(1).head().asNumber()*yscale;
+	double point1x = point1.tailAt(0).head().asNumber()*xscale;
+	double point1y = -point1.tailAt(1).head().asNumber()*yscale;
+	double point2x = point2.tailAt(0).head().asNumber()*xscale;
+	double point2y = -point2.tailAt(1).head().asNumber()*yscale;
 
 	std::vector<Expression> make_line;
 	std::vector<Expression> point1Vec;
@@ -632,8 +919,8 @@ Expression makeLineFromPoints(const Expression& point1, const Expression& point2
 	make_line.push_back(point1Vec);
 	make_line.push_back(point2Vec);
 	Expression line = Expression(make_line);
-	line.setProperty("\"object-name\"", LINE);
-	line.setProperty("\"thickness\"", THICKNESS);
+	line.setProperty(OBJECT_NAME_KEY, LINE);
+	line.setProperty(THICKNESS_KEY, THICKNESS);
 
 	return line;
 };
@@ -710,9 +997,9 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	Expression LINE(Atom("\"line\""));
 	Expression TEXT(Atom("\"text\""));
 
-	double x_min = args.at(0).getTail().at(0).getTail().at(0).head().asNumber();
+	double x_min = args.at(0).tailAt(0).tailAt(0).head().asNumber();
 	double x_max = x_min;
-	double y_min = args.at(0).getTail().at(0).getTail().at(1).head().asNumber();
+	double y_min = args.at(0).tailAt(0).tailAt(1).head().asNumber();
 	double y_max = y_min;
 	
 	Expression data = args.at(0);
@@ -721,9 +1008,10 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	std::vector<Expression> points;
 
 	//Calculate x and y bounds
-	for (auto d : data.getTail()) {
-		double x_point = d.getTail().at(0).head().asNumber();
-		double y_point = d.getTail().at(1).head().asNumber();
+	for (std::size_t i = 0; i < data.tailLength(); i++) {
+		Expression d = data.tailAt(i);
+		double x_point = d.tailAt(0).head().asNumber();
+		double y_point = d.tailAt(1).head().asNumber();
 
 		if (x_point > x_max) x_max = x_point;
 		if (x_point < x_min) x_min = x_point;
@@ -738,13 +1026,14 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	double ymiddle = (y_max + y_min) / 2;
 
 	//Add each point from the data list
-	for (auto a : data.getTail()) {
+	for (std::size_t i = 0; i < data.tailLength(); i++) {
+		Expression a = data.tailAt(i);
 		std::vector<Expression> make_point;
-		make_point.push_back(Expression(a.getTail().at(0).head().asNumber() * xscale));
-		make_point.push_back(Expression(-a.getTail().at(1).head().asNumber() * yscale));
+		make_point.push_back(Expression(a.tailAt(0).head().asNumber() * xscale));
+		make_point.push_back(Expression(-a.tailAt(1).head().asNumber() * yscale));
 		Expression point = Expression(make_point);
-		point.setProperty("\"object-name\"", POINT);
-		point.setProperty("\"size\"",SIZE);
+		point.setProperty(OBJECT_NAME_KEY, POINT);
+		point.setProperty(SIZE_KEY,SIZE);
 		points.push_back(point);
 
 		std::vector<Expression> make_axis_point;
@@ -752,19 +1041,19 @@ Expression discrete_plot(std::vector<Expression> & args) {
 
 		//Draw line to min axis if  y = 0 is not present
 		if (y_min > 0) {
-			make_axis_point.push_back(Expression(a.getTail().at(0).head().asNumber() * xscale));
+			make_axis_point.push_back(Expression(a.tailAt(0).head().asNumber() * xscale));
 			make_axis_point.push_back(Expression(-y_min*yscale));
 			axis_point = Expression(make_axis_point);
 		}
 		//Draw line to max axis if  y = 0 is not present
 		else if (y_max < 0) {
-			make_axis_point.push_back(Expression(a.getTail().at(0).head().asNumber() * xscale));
+			make_axis_point.push_back(Expression(a.tailAt(0).head().asNumber() * xscale));
 			make_axis_point.push_back(Expression(-y_max*yscale));
 			axis_point = Expression(make_axis_point);
 		}
 		//Draw line to y axis if present
 		else{
-			make_axis_point.push_back(Expression(a.getTail().at(0).head().asNumber() * xscale));
+			make_axis_point.push_back(Expression(a.tailAt(0).head().asNumber() * xscale));
 			make_axis_point.push_back(Expression(0));
 			axis_point = Expression(make_axis_point);
 		}
@@ -773,8 +1062,8 @@ Expression discrete_plot(std::vector<Expression> & args) {
 		make_line.push_back(point);
 		make_line.push_back(axis_point);
 		Expression line = Expression(make_line);
-		line.setProperty("\"object-name\"", LINE);
-		line.setProperty("\"thickness\"", THICKNESS);
+		line.setProperty(OBJECT_NAME_KEY, LINE);
+		line.setProperty(THICKNESS_KEY, THICKNESS);
 		ret.push_back(line);
 	}
 
@@ -803,34 +1092,36 @@ Expression discrete_plot(std::vector<Expression> & args) {
 
 	Expression textScale = Expression(1);
 	//Check if a new scale is given
-	for (auto z : options.getTail()) {
-		if (z.getTail().at(0).head() == Atom("\"text-scale\"")) {
-			textScale = z.getTail().at(1);
+	for (std::size_t i = 0; i < options.tailLength(); i++) {
+		Expression z = options.tailAt(i);
+		if (z.tailAt(0).head() == Atom("\"text-scale\"")) {
+			textScale = z.tailAt(1);
 		}
 	}
 
 	//Find the options
-	for (auto o : options.getTail()) {
-		Expression text = o.getTail().at(1);
-		text.setProperty("\"object-name\"", TEXT);
-
-		if (o.getTail().at(0).head() == Atom("\"title\"")) {
-			text.setProperty("\"position\"", titlepositionexp);
-			text.setProperty("\"text-scale\"", textScale);
-			text.setProperty("\"text-rotation\"", Expression(0));
+	for (std::size_t i = 0; i < options.tailLength(); i++) {
+		Expression o = options.tailAt(i);
+		Expression text = o.tailAt(1);
+		text.setProperty(OBJECT_NAME_KEY, TEXT);
+
+		if (o.tailAt(0).head() == Atom("\"title\"")) {
+			text.setProperty(POSITION_KEY, titlepositionexp);
+			text.setProperty(TEXT_SCALE_KEY, textScale);
+			text.setProperty(TEXT_ROTATION_KEY, Expression(0));
 			ret.push_back(text);
 		}
-		else if (o.getTail().at(0).head() == Atom("\"abscissa-label\"")) {
-			text.setProperty("\"position\"", xlabelexp);
-			text.setProperty("\"text-scale\"", textScale);
-			text.setProperty("\"text-rotation\"", Expression(0));
+		else if (o.tailAt(0).head() == Atom("\"abscissa-label\"")) {
+			text.setProperty(POSITION_KEY, xlabelexp);
+			text.setProperty(TEXT_SCALE_KEY, textScale);
+			text.setProperty(TEXT_ROTATION_KEY, Expression(0));
 			ret.push_back(text);
 		}
-		else if (o.getTail().at(0).head() == Atom("\"ordinate-label\"")) {
-			text.setProperty("\"position\"", ylabelexp);
+		else if (o.tailAt(0).head() == Atom("\"ordinate-label\"")) {
+			text.setProperty(POSITION_KEY, ylabelexp);
 			Expression rotate = Expression(std::atan2(0, -1) / 2);
-			text.setProperty("\"text-rotation\"", rotate);
-			text.setProperty("\"text-scale\"", textScale);
+			text.setProperty(TEXT_ROTATION_KEY, rotate);
+			text.setProperty(TEXT_SCALE_KEY, textScale);
 			ret.push_back(text);
 		}
 	}
@@ -842,10 +1133,10 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	std::stringstream xmin;
 	xmin << "\"" << std::setprecision(2) << x_min << "\"";
 	Expression xminlabel = Expression(Atom(xmin.str()));
-	xminlabel.setProperty("\"object-name\"", TEXT);
-	xminlabel.setProperty("\"position\"", xminlabelpos);
-	xminlabel.setProperty("\"text-scale\"", textScale);
-	xminlabel.setProperty("\"text-rotation\"", Expression(0));
+	xminlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	xminlabel.setProperty(POSITION_KEY, xminlabelpos);
+	xminlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	xminlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(xminlabel);
 
 	Expression xmaxlabelpos(Atom("list"));
@@ -855,10 +1146,10 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	std::stringstream xmax;
 	xmax << "\"" << std::setprecision(2) << x_max << "\"";
 	Expression xmaxlabel = Expression(Atom(xmax.str()));
-	xmaxlabel.setProperty("\"object-name\"", TEXT);
-	xmaxlabel.setProperty("\"position\"", xmaxlabelpos);
-	xmaxlabel.setProperty("\"text-scale\"", textScale);
-	xmaxlabel.setProperty("\"text-rotation\"", Expression(0));
+	xmaxlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	xmaxlabel.setProperty(POSITION_KEY, xmaxlabelpos);
+	xmaxlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	xmaxlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(xmaxlabel);
 
 	Expression yminlabelpos(Atom("list"));
@@ -868,10 +1159,10 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	std::stringstream ymin;
 	ymin << "\"" << std::setprecision(2) << y_min << "\"";
 	Expression yminlabel = Expression(Atom(ymin.str()));
-	yminlabel.setProperty("\"object-name\"", TEXT);
-	yminlabel.setProperty("\"position\"", yminlabelpos);
-	yminlabel.setProperty("\"text-scale\"", textScale);
-	yminlabel.setProperty("\"text-rotation\"", Expression(0));
+	yminlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	yminlabel.setProperty(POSITION_KEY, yminlabelpos);
+	yminlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	yminlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(yminlabel);
 
 	Expression ymaxlabelpos(Atom("list"));
@@ -881,28 +1172,28 @@ Expression discrete_plot(std::vector<Expression> & args) {
 	std::stringstream ymax;
 	ymax << "\"" << std::setprecision(2) << y_max << "\"";
 	Expression ymaxlabel = Expression(Atom(ymax.str()));
-	ymaxlabel.setProperty("\"object-name\"", TEXT);
-	ymaxlabel.setProperty("\"position\"", ymaxlabelpos);
-	ymaxlabel.setProperty("\"text-scale\"", textScale);
-	ymaxlabel.setProperty("\"text-rotation\"", Expression(0));
+	ymaxlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	ymaxlabel.setProperty(POSITION_KEY, ymaxlabelpos);
+	ymaxlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	ymaxlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(ymaxlabel);
 
 
-	return Expression(ret);
+	return Expression(std::move(ret));
 };
 
 
 //Algorithm to split lines who's angle is less than 175 degrees to smooth the plot
 void recursiveLineSplitAlgorithm(std::vector<Expression>& ret, double xscale, double yscale, std::size_t z /*index*/) {
-	float point1x = ret.at(z).getTail().at(0).getTail().at(0).head().asNumber() / xscale;
-	float point1y = -ret.at(z).getTail().at(0).getTail().at(1).head().asNumber() / yscale;
-	float point2x = ret.at(z).getTail().at(1).getTail().at(0).head().asNumber() / xscale;
-	float point2y = -ret.at(z).getTail().at(1).getTail().at(1).head().asNumber() / yscale;
+	float point1x = ret.at(z).tailAt(0).tailAt(0).head().asNumber() / xscale;
+	float point1y = -ret.at(z).tailAt(0).tailAt(1).head().asNumber() / yscale;
+	float point2x = ret.at(z).tailAt(1).tailAt(0).head().asNumber() / xscale;
+	float point2y = -ret.at(z).tailAt(1).tailAt(1).head().asNumber() / yscale;
 
-	float point3x = ret.at(z + 1).getTail().at(0).getTail().at(0).head().asNumber() / xscale;
-	float point3y = -ret.at(z + 1).getTail().at(0).getTail().at(1).head().asNumber() / yscale;
-	float point4x = ret.at(z + 1).getTail().at(1).getTail().at(0).head().asNumber() / xscale;
-	float point4y = -ret.at(z + 1).getTail().at(1).getTail().at(1).head().asNumber() / yscale;
+	float point3x = ret.at(z + 1).tailAt(0).tailAt(0).head().asNumber() / xscale;
+	float point3y = -ret.at(z + 1).tailAt(0).tailAt(1).head().asNumber() / yscale;
+	float point4x = ret.at(z + 1).tailAt(1).tailAt(0).head().asNumber() / xscale;
+	float point4y = -ret.at(z + 1).tailAt(1).tailAt(1).head().asNumber() / yscale;
 
 	double slope1 = (point2y - point1y) / (point2x - point1x);
 	double slope2 = (point4y - point3y) / (point4x - point3x);
@@ -964,7 +1255,7 @@ void recursiveLineSplitAlgorithm(std::vector<Expression>& ret, double xscale, do
 
 
 //Function returns a list of lines and texts to create a continuous plot
-Expression continuous_plot(const std::vector<Expression> & args, Environment & env) {
+Expression continuous_plot(std::vector<Expression> & args, Environment & env) {
 	const Expression TEXT(Atom("\"text\""));
 
 	Expression func = args.at(0);
@@ -975,27 +1266,38 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	std::vector<Expression> points;
 
 	//Get the x bounds from second list and calculate the scale/middle
-	double x_min = bounds.getTail().at(0).head().asNumber();
-	double x_max = bounds.getTail().at(1).head().asNumber();
+	double x_min = bounds.tailAt(0).head().asNumber();
+	double x_max = bounds.tailAt(1).head().asNumber();
 	double pointSpacing = (x_max - x_min) / 50;
 
 	double xscale = 20 / (x_max - x_min);
 	double xmiddle = (x_max + x_min) / 2;
 
-	Expression lambdaVariable = func.getTail().at(0).getTail().at(0);
+	Expression lambdaVariable = func.tailAt(0).tailAt(0);
 
-	Expression lambdaFunc = func.getTail().at(1);
+	Expression lambdaFunc = func.tailAt(1);
 
-	//Begin by adding 51 points to a vector of points
+	//The 51 x positions to sample
+	std::vector<double> xs;
 	for (double i = x_min; i <= (x_max + pointSpacing); i += pointSpacing) {
-	
-		Environment temp(env);
-		temp.add_exp(lambdaVariable.head(), Expression(i), true);
+		xs.push_back(i);
+	}
 
-		Expression tempExp = Expression(args.at(0).getTail()).eval(temp);
-		Expression y_point = tempExp.getTail().at(1);
+	//Evaluate the function at the samples in parallel, in chunks that each bind the parameter in one scope frame
+	std::vector<Expression> ys(xs.size());
+	ThreadPool & pool = ThreadPool::shared();
+	std::size_t chunks = pool.chunks(xs.size());
+	pool.run(chunks, [&](std::size_t c) {
+		Environment temp(&env);
+		for (std::size_t k = xs.size() * c / chunks; k < xs.size() * (c + 1) / chunks; k++) {
+			env.check_interrupt();
+			temp.add_exp(lambdaVariable.head(), Expression(xs[k]), true);
+			ys[k] = lambdaFunc.eval(temp);
+		}
+	});
 
-		std::vector<Expression> point = {Expression(i),y_point};
+	for (std::size_t k = 0; k < xs.size(); k++) {
+		std::vector<Expression> point = {Expression(xs[k]), ys[k]};
 		points.push_back(Expression(point));
 	}
 
@@ -1004,7 +1306,7 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 
 	//Use the present points to determine the y bounds, then calculate scale and middle
 	for (auto a : points) {
-		double y = a.getTail().at(1).head().asNumber();
+		double y = a.tailAt(1).head().asNumber();
 		if (y > y_max) y_max = y;
 		if (y < y_min) y_min = y;
 	}
@@ -1023,6 +1325,7 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 		std::size_t size = ret.size();
 		//Run through graph searching for angles <175 in algorithm
 		for (std::size_t z = 0; z < size - 1; z++) {
+			env.check_interrupt();
 			recursiveLineSplitAlgorithm(ret, xscale, yscale, z);
 		}
 	}
@@ -1052,33 +1355,35 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	if (args.size() == 3) {
 		Expression options = args.at(2);
 
-		for (auto z : options.getTail()) {
-			if (z.getTail().at(0).head() == Atom("\"text-scale\"")) {
-				textScale = z.getTail().at(1);
+		for (std::size_t i = 0; i < options.tailLength(); i++) {
+			Expression z = options.tailAt(i);
+			if (z.tailAt(0).head() == Atom("\"text-scale\"")) {
+				textScale = z.tailAt(1);
 			}
 		}
 
-		for (auto o : options.getTail()) {
-			Expression text = o.getTail().at(1);
-			text.setProperty("\"object-name\"", TEXT);
+		for (std::size_t i = 0; i < options.tailLength(); i++) {
+			Expression o = options.tailAt(i);
+			Expression text = o.tailAt(1);
+			text.setProperty(OBJECT_NAME_KEY, TEXT);
 
-			if (o.getTail().at(0).head() == Atom("\"title\"")) {
-				text.setProperty("\"position\"", titlepositionexp);
-				text.setProperty("\"text-scale\"", textScale);
-				text.setProperty("\"text-rotation\"", Expression(0));
+			if (o.tailAt(0).head() == Atom("\"title\"")) {
+				text.setProperty(POSITION_KEY, titlepositionexp);
+				text.setProperty(TEXT_SCALE_KEY, textScale);
+				text.setProperty(TEXT_ROTATION_KEY, Expression(0));
 				ret.push_back(text);
 			}
-			else if (o.getTail().at(0).head() == Atom("\"abscissa-label\"")) {
-				text.setProperty("\"position\"", xlabelexp);
-				text.setProperty("\"text-scale\"", textScale);
-				text.setProperty("\"text-rotation\"", Expression(0));
+			else if (o.tailAt(0).head() == Atom("\"abscissa-label\"")) {
+				text.setProperty(POSITION_KEY, xlabelexp);
+				text.setProperty(TEXT_SCALE_KEY, textScale);
+				text.setProperty(TEXT_ROTATION_KEY, Expression(0));
 				ret.push_back(text);
 			}
-			else if (o.getTail().at(0).head() == Atom("\"ordinate-label\"")) {
-				text.setProperty("\"position\"", ylabelexp);
+			else if (o.tailAt(0).head() == Atom("\"ordinate-label\"")) {
+				text.setProperty(POSITION_KEY, ylabelexp);
 				Expression rotate = Expression(std::atan2(0, -1) / 2);
-				text.setProperty("\"text-rotation\"", rotate);
-				text.setProperty("\"text-scale\"", textScale);
+				text.setProperty(TEXT_ROTATION_KEY, rotate);
+				text.setProperty(TEXT_SCALE_KEY, textScale);
 				ret.push_back(text);
 			}
 		}
@@ -1091,10 +1396,10 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	std::stringstream xmin;
 	xmin << "\"" << std::setprecision(2) << x_min << "\"";
 	Expression xminlabel = Expression(Atom(xmin.str()));
-	xminlabel.setProperty("\"object-name\"", TEXT);
-	xminlabel.setProperty("\"position\"", xminlabelpos);
-	xminlabel.setProperty("\"text-scale\"", textScale);
-	xminlabel.setProperty("\"text-rotation\"", Expression(0));
+	xminlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	xminlabel.setProperty(POSITION_KEY, xminlabelpos);
+	xminlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	xminlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(xminlabel);
 
 	Expression xmaxlabelpos(Atom("list"));
@@ -1104,10 +1409,10 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	std::stringstream xmax;
 	xmax << "\"" << std::setprecision(2) << x_max << "\"";
 	Expression xmaxlabel = Expression(Atom(xmax.str()));
-	xmaxlabel.setProperty("\"object-name\"", TEXT);
-	xmaxlabel.setProperty("\"position\"", xmaxlabelpos);
-	xmaxlabel.setProperty("\"text-scale\"", textScale);
-	xmaxlabel.setProperty("\"text-rotation\"", Expression(0));
+	xmaxlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	xmaxlabel.setProperty(POSITION_KEY, xmaxlabelpos);
+	xmaxlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	xmaxlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(xmaxlabel);
 
 	Expression yminlabelpos(Atom("list"));
@@ -1117,10 +1422,10 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	std::stringstream ymin;
 	ymin << "\"" << std::setprecision(2) << y_min << "\"";
 	Expression yminlabel = Expression(Atom(ymin.str()));
-	yminlabel.setProperty("\"object-name\"", TEXT);
-	yminlabel.setProperty("\"position\"", yminlabelpos);
-	yminlabel.setProperty("\"text-scale\"", textScale);
-	yminlabel.setProperty("\"text-rotation\"", Expression(0));
+	yminlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	yminlabel.setProperty(POSITION_KEY, yminlabelpos);
+	yminlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	yminlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(yminlabel);
 
 	Expression ymaxlabelpos(Atom("list"));
@@ -1130,49 +1435,50 @@ Expression continuous_plot(const std::vector<Expression> & args, Environment & e
 	std::stringstream ymax;
 	ymax << "\"" << std::setprecision(2) << y_max << "\"";
 	Expression ymaxlabel = Expression(Atom(ymax.str()));
-	ymaxlabel.setProperty("\"object-name\"", TEXT);
-	ymaxlabel.setProperty("\"position\"", ymaxlabelpos);
-	ymaxlabel.setProperty("\"text-scale\"", textScale);
-	ymaxlabel.setProperty("\"text-rotation\"", Expression(0));
+	ymaxlabel.setProperty(OBJECT_NAME_KEY, TEXT);
+	ymaxlabel.setProperty(POSITION_KEY, ymaxlabelpos);
+	ymaxlabel.setProperty(TEXT_SCALE_KEY, textScale);
+	ymaxlabel.setProperty(TEXT_ROTATION_KEY, Expression(0));
 	ret.push_back(ymaxlabel);
 
 	
-	return Expression(ret);
+	return Expression(std::move(ret));
 };
 
 
 
 
 //Binary procedure (first arg is a procedure, second a list) to apply a procedure to each element in a list
-Expression apply(const std::vector<Expression> & args, Environment & env) {
+Expression apply(std::vector<Expression> & args, Environment & env) {
 
 	if (nargs_equal(args, 2)) {
-		if (args[1].head() == Atom("list")) {
+		if (args[1].isHeadList()) {
 			if (env.is_proc(args[0].head()) ) {
 					Expression ret(args[0].head());
-					for (auto a : args[1].getTail()) {
-						ret.append(a.head());
+					for (std::size_t i = 0; i < args[1].tailLength(); i++) {
+						ret.append(args[1].tailAt(i).head());
 					}
 
 					return ret.eval(env);
 			}
-			else if (args[0].head() == Atom("lambda")) {
+			else if (args[0].isHeadLambda()) {
+				env.check_interrupt();
 				//get the lambda expression
 				Expression lambdaExp = args[0];
-				//create new environment
-				Environment newEnv = Environment(env);
+				//create a scope frame for the parameters
+				Environment newEnv(&env);
 
 				//get the list of parameter symbols
-				std::vector<Expression> params = lambdaExp.getTail().at(0).getTail();
+				const std::vector<Expression> & params = lambdaExp.getTail().at(0).getTail();
 
 				//if the size of the arguments and the size of the inputs dont match throw an error
-				if (params.size() != args.at(1).getTail().size()) {
+				if (params.size() != args.at(1).tailLength()) {
 					throw SemanticError("Error during evaluation: lambda function called with incorrect number of args");
 				}
 
 				//save the inputs as known expressions
 				for (size_t i = 0; i < params.size(); i++) {
-					newEnv.add_exp(params[i].head(), args.at(1).getTail().at(i), true);
+					newEnv.add_exp(params[i].head(), args.at(1).tailAt(i), true);
 				}
 
 				//return the evaluation
@@ -1194,76 +1500,118 @@ Expression apply(const std::vector<Expression> & args, Environment & env) {
 };
 
 
-//Binary procedure (first arg is a procedure, second a list) to map a procedure to each element in a list
-Expression map(const std::vector<Expression> & args, Environment & env) {
-	if (nargs_equal(args, 2)) {
-		if (args[1].head() == Atom("list")) {
-			//If the first arg is a procedure (not lambda)
-			if (env.is_proc(args[0].head())) {
-				//create a return list of values as answer
-					Expression ret(Atom("list"));
-					//for each input parameter
-					for (auto a : args[1].getTail()) {
-						Expression val(args[0].head());
-						//if its a list, throw an error
-						if (a.head() == Atom("list")) {
-							throw SemanticError("Error in call to map, invalid list argument");
-						}
-						//not list, just grab the number
-						else {
-							val.append(a.head());
-						}
-						//evaluate and add to list of answers
-						val = val.eval(env);
-						if (val.isHeadNumber()) {
-							ret.append(val.head().asNumber());
-						}
-						else if (val.isHeadComplex()) {
-							ret.append(val.head().asComplex());
-						}
-					}
-					return ret;
-			}
-			else if (args[0].isHeadLambda()) {
-				//create new environment
-				Environment newEnv = Environment(env);
-				//get the list of parameter symbols
-				std::vector<Expression> params = args.at(0).getTail().at(0).getTail();
-				std::vector<Expression> inputs = args[1].getTail();
-
-
-				std::vector<Expression> ret;
-				Expression val;
-
-				if (params.size() != 1) {
-					throw SemanticError("Error in call to map, cannot map to lambda with multiple inputs");
-				}
-
-				for (auto a : inputs) {
-					//save the inputs as known expressions
-					for (size_t i = 0; i < params.size(); i++) {
-						newEnv.add_exp(params[i].head(), a, true);
-					}
-
-					//evaluate with that input
-					val = args.at(0).getTail().at(1).eval(newEnv);
-					ret.push_back(val);
-				}
-				return Expression(ret);
+// check the arguments of map or pmap (named name): a procedure or a lambda of
+// one parameter, and a list
+static void check_map_args(const std::vector<Expression> & args, const Environment & env, const std::string & name) {
+	if (!nargs_equal(args, 2)) {
+		throw SemanticError("Error in call to " + name + ": invalid number of arguments.");
+	}
+	if (!args[1].isHeadList()) {
+		throw SemanticError("Error in call to " + name + ": second arg needs to be list");
+	}
+	if (env.is_proc(args[0].head())) {
+		return;
+	}
+	if (!args[0].isHeadLambda()) {
+		throw SemanticError("Error in call to " + name + ": first arg must be a procedure or lambda function");
+	}
+	if (args[0].getTail().at(0).tailLength() != 1) {
+		throw SemanticError("Error in call to " + name + ", cannot map to lambda with multiple inputs");
+	}
+}
 
+// map the procedure or lambda args[0] over elements [begin, end) of the list
+// args[1], appending the results to ret. A lambda gets one scope frame for
+// the whole range. The arguments must have passed check_map_args
+static void map_range(const std::vector<Expression> & args, Environment & env, const std::string & name,
+	std::size_t begin, std::size_t end, std::vector<Expression> & ret) {
+
+	if (env.is_proc(args[0].head())) {
+		Procedure proc = env.get_proc(args[0].head());
+		std::vector<Expression> procArgs;
+		//a packed list is walked without unpacking it
+		const PackedTail * packed = args[1].packed();
+		for (std::size_t i = begin; i < end; i++) {
+			env.check_interrupt();
+			// the procedure owns its arguments, so they are set up afresh each call
+			procArgs.clear();
+			if (packed) {
+				procArgs.push_back(packed->complex ? Expression(packed->complexes[i]) : Expression(packed->numbers[i]));
 			}
 			else {
-				throw SemanticError("Error in call to map: first arg must be a procedure or lambda function");
+				const Expression & a = args[1].getTail()[i];
+				//if its a list, throw an error
+				if (a.isHeadList()) {
+					throw SemanticError("Error in call to " + name + ", invalid list argument");
+				}
+				//not list, just grab the number
+				procArgs.push_back(Expression(a.head()));
+			}
+			//evaluate and add to list of answers
+			Expression val = proc(procArgs);
+			if (val.isHeadNumber() || val.isHeadComplex()) {
+				ret.push_back(Expression(val.head()));
 			}
-		}
-		else {
-			throw SemanticError("Error in call to map: second arg needs to be list");
 		}
 	}
 	else {
-		throw SemanticError("Error in call to map: invalid number of arguments.");
+		//create a scope frame for the parameter
+		Environment newEnv(&env);
+		const Atom & param = args[0].getTail()[0].getTail()[0].head();
+		const Expression & body = args[0].getTail().at(1);
+		//a packed list is walked without unpacking it, so chunks share nothing but the list
+		const PackedTail * packed = args[1].packed();
+
+		for (std::size_t i = begin; i < end; i++) {
+			env.check_interrupt();
+			//save the input as a known expression and evaluate with it
+			if (packed) {
+				newEnv.add_exp(param, packed->complex ? Expression(packed->complexes[i]) : Expression(packed->numbers[i]), true);
+			}
+			else {
+				newEnv.add_exp(param, args[1].getTail()[i], true);
+			}
+			ret.push_back(body.eval(newEnv));
+		}
+	}
+}
+
+//Binary procedure (first arg is a procedure, second a list) to map a procedure to each element in a list
+Expression map(std::vector<Expression> & args, Environment & env) {
+	check_map_args(args, env, "map");
+
+	std::vector<Expression> ret;
+	map_range(args, env, "map", 0, args[1].tailLength(), ret);
+	return Expression::makeList(std::move(ret));
+};
+
+//Binary procedure like map, but the list is split into chunks that are mapped in parallel on the shared
+//ThreadPool. Each chunk has its own scope frame, and the results are joined in the order of the list
+Expression pmap(std::vector<Expression> & args, Environment & env) {
+	check_map_args(args, env, "pmap");
+
+	ThreadPool & pool = ThreadPool::shared();
+	std::size_t n = args[1].tailLength();
+
+	std::size_t chunks = pool.chunks(n);
+	if (chunks < 2) {
+		std::vector<Expression> ret;
+		map_range(args, env, "pmap", 0, n, ret);
+		return Expression::makeList(std::move(ret));
 	}
 
+	// the chunks only read the list and the environment
+	std::vector<std::vector<Expression>> results(chunks);
+	pool.run(chunks, [&](std::size_t c) {
+		map_range(args, env, "pmap", n * c / chunks, n * (c + 1) / chunks, results[c]);
+	});
+
+	std::vector<Expression> ret;
+	ret.reserve(n);
+	for (auto & chunk : results) {
+		std::move(chunk.begin(), chunk.end(), std::back_inserter(ret));
+	}
+	return Expression::makeList(std::move(ret));
 };
 
 //Function that adds a the second Expression with the key being the first Expression (if string) 
@@ -1271,7 +1619,7 @@ Expression map(const std::vector<Expression> & args, Environment & env) {
 Expression set_property(std::vector<Expression> & args) {
 	if (nargs_equal(args, 3)) {
 		if (args[0].isHeadString()) {
-			args.at(2).setProperty(args.at(0).head().asString(), args.at(1));
+			args.at(2).setProperty(args.at(0).head().asSymbolId(), args.at(1));
 		}
 		else {
 			throw SemanticError("Error in call to set-property, first argument not a string");
@@ -1281,14 +1629,14 @@ Expression set_property(std::vector<Expression> & args) {
 		throw SemanticError("Error in call to set-property, need 3 arguments");
 	}
 
-	return args[2];
+	return std::move(args[2]);
 };
 
 //Returns the property given the first arg is a string key and second arg has that property
 Expression get_property(std::vector<Expression> & args) {
 	if (nargs_equal(args, 2)) {
 		if (args[0].isHeadString()) {
-				return args.at(1).getProperty(args.at(0).head().asString());
+				return args.at(1).getProperty(args.at(0).head().asSymbolId());
 		}
 		else {
 			throw SemanticError("Error in call to get-property, first argument not a string");
@@ -1305,33 +1653,184 @@ Expression get_property(std::vector<Expression> & args) {
 
 /////////////////////////////////////////End of defined procedures
 
-Environment::Environment(){
+Environment::Environment(): parent(nullptr), interrupt(nullptr){
 
   reset();
 }
 
+Environment::Environment(const Environment * parent):
+  locals(ArenaAllocator<Local>(Arena::current())),
+  parent(parent), interrupt(parent ? parent->interrupt : nullptr) {}
+
+Environment::Environment(std::shared_ptr<const Environment> snapshot):
+  parent(snapshot.get()), base(snapshot), interrupt(nullptr) {}
+
+std::shared_ptr<const Environment> Environment::snapshot() const{
+
+  std::shared_ptr<Environment> copy = std::make_shared<Environment>(*this);
+  copy->interrupt = nullptr;
+
+  return copy;
+}
+
+void Environment::set_interrupt(const Interrupt * flag) noexcept{
+  interrupt = flag;
+}
+
+// slot of a symbol in a table of capacity mask + 1. Interned handles are
+// aligned addresses, so the low bits are mixed in from the high ones
+static std::size_t slot_of(SymbolId key, std::size_t mask, std::uint64_t seed = 0x9E3779B97F4A7C15ull){
+  std::uint64_t h = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key)) * seed;
+  return static_cast<std::size_t>(h ^ (h >> 32)) & mask;
+}
+
+const Environment::Binding * Environment::BindingTable::find(SymbolId key) const noexcept{
+  if(count == 0) return nullptr;
+
+  std::size_t mask = slots.size() - 1;
+  for(std::size_t i = slot_of(key, mask); ; i = (i + 1) & mask){
+    const Slot & slot = slots[i];
+    if(slot.key == key) return &slot.value;
+    if(slot.key == nullptr) return nullptr;
+  }
+}
+
+Environment::Binding & Environment::BindingTable::insert(SymbolId key){
+  if(2 * (count + 1) > slots.size()) grow();
+
+  std::size_t mask = slots.size() - 1;
+  std::size_t i = slot_of(key, mask);
+  while(slots[i].key != nullptr && slots[i].key != key){
+    i = (i + 1) & mask;
+  }
+
+  Slot & slot = slots[i];
+  if(slot.key == nullptr){
+    slot.key = key;
+    ++count;
+  }
+  return slot.value;
+}
+
+void Environment::BindingTable::clear() noexcept{
+  for(Slot & slot : slots){
+    slot.key = nullptr;
+    slot.value = Binding();
+  }
+  count = 0;
+}
+
+void Environment::BindingTable::grow(){
+  std::vector<Slot> old(slots.size() == 0 ? 4 : 2 * slots.size());
+  old.swap(slots);
+
+  std::size_t mask = slots.size() - 1;
+  for(Slot & slot : old){
+    if(slot.key == nullptr) continue;
+    std::size_t i = slot_of(slot.key, mask);
+    while(slots[i].key != nullptr) i = (i + 1) & mask;
+    slots[i].key = slot.key;
+    slots[i].value = std::move(slot.value);
+  }
+}
+
+namespace {
+
+/* The built-in procedures and values. They are found through a perfect hash:
+   a multiplier is searched for, once, under which every built-in has a slot
+   of its own, so looking a symbol up here is always a single probe. The
+   table is built on first use and never changes, so any number of
+   environments and threads share it. */
+class BuiltinTable {
+public:
+  BuiltinTable();
+
+  const Environment::Binding * find(SymbolId key) const noexcept{
+    const Entry & entry = slots[slot_of(key, mask, seed)];
+    return (entry.key == key) ? &values[entry.index] : nullptr;
+  }
+
+private:
+  struct Entry {
+    SymbolId key;
+    std::size_t index;
+  };
+
+  std::vector<SymbolId> keys;
+  std::vector<Environment::Binding> values;
+
+  std::vector<Entry> slots;
+  std::size_t mask;
+  std::uint64_t seed;
+
+  void define(const char * name, const Environment::Binding & value){
+    keys.push_back(intern(name));
+    values.push_back(value);
+  }
+
+  // try to place every key with the current mask and seed
+  bool place();
+};
+
+bool BuiltinTable::place(){
+  slots.assign(mask + 1, Entry{nullptr, 0});
+  for(std::size_t k = 0; k < keys.size(); ++k){
+    Entry & entry = slots[slot_of(keys[k], mask, seed)];
+    if(entry.key != nullptr) return false;
+    entry = Entry{keys[k], k};
+  }
+  return true;
+}
+
+const BuiltinTable & builtins(){
+  static const BuiltinTable table;
+  return table;
+}
+
+}
+
+const Environment::Binding * Environment::find(const Atom & sym) const{
+  if(!sym.isSymbol()) return nullptr;
+
+  SymbolId name = sym.asSymbolId();
+
+  // a parameter of the lambda this frame belongs to is found by its slot.
+  // The name is checked, since the body of a lambda can be evaluated in
+  // another frame by built-ins such as continuous-plot
+  std::uint32_t slot = sym.slot();
+  if(slot < locals.size() && locals[slot].first == name){
+    return &locals[slot].second;
+  }
+
+  // walk outward through the enclosing frames
+  for(const Environment * scope = this; scope != nullptr; scope = scope->parent){
+    for(const auto & local : scope->locals){
+      if(local.first == name) return &local.second;
+    }
+    if(const Binding * result = scope->bindings.find(name)){
+      return result;
+    }
+  }
+
+  return builtins().find(name);
+}
+
 bool Environment::is_known(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  return envmap.find(sym.asSymbol()) != envmap.end();
+  return find(sym) != nullptr;
 }
 
 bool Environment::is_exp(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ExpressionType);
+  const Binding * result = find(sym);
+  return (result != nullptr) && (result->type == ExpressionType);
 }
 
 Expression Environment::get_exp(const Atom & sym) const{
 
   Expression exp;
   
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
-    }
+  const Binding * result = find(sym);
+  if((result != nullptr) && (result->type == ExpressionType)){
+    exp = result->exp;
   }
 
   return exp;
@@ -1344,181 +1843,179 @@ void Environment::add_exp(const Atom & sym, const Expression & exp, bool lambdaF
     throw SemanticError("Attempt to add non-symbol to environment");
   }
 
-  // error if overwriting symbol map
-  if((envmap.find(sym.asSymbol()) != envmap.end()) && !lambdaFlag){
-    //throw SemanticError("Attempt to overwrite symbol in environemnt");
-  }
-
   if (lambdaFlag) {
-	  envmap.erase(sym.asSymbol());
-	  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp));
+	  // parameters always bind in this frame, shadowing any outer binding
+	  SymbolId name = sym.asSymbolId();
+	  for (auto & local : locals) {
+		  if (local.first == name) {
+			  local.second = Binding(exp);
+			  return;
+		  }
+	  }
+	  locals.emplace_back(name, Binding(exp));
   }
-  else {
-	  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp));
+  else if (!is_known(sym)) {
+	  // a define never overwrites a symbol visible from this frame
+	  bindings.insert(sym.asSymbolId()) = Binding(exp);
   }
 }
 
 bool Environment::is_proc(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ProcedureType);
+  const Binding * result = find(sym);
+  return (result != nullptr) && (result->type == ProcedureType);
 }
 
 Procedure Environment::get_proc(const Atom & sym) const{
 
-  //Procedure proc = default_proc;
-
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ProcedureType)){
-      return result->second.proc;
-    }
+  const Binding * result = find(sym);
+  if((result != nullptr) && (result->type == ProcedureType)){
+    return result->proc;
   }
 
   return default_proc;
 }
 
 bool Environment::is_proc_bi(const Atom & sym) const {
-	if (!sym.isSymbol()) return false;
-
-	auto result = envmap.find(sym.asSymbol());
-	return (result != envmap.end()) && (result->second.type == ProcedureBiType);
+	const Binding * result = find(sym);
+	return (result != nullptr) && (result->type == ProcedureBiType);
 }
 
 Procedure_bi Environment::get_proc_bi(const Atom & sym) const {
 
-	if (sym.isSymbol()) {
-		auto result = envmap.find(sym.asSymbol());
-		if ((result != envmap.end()) && (result->second.type == ProcedureBiType)) {
-			return result->second.proc_bi;
-		}
+	const Binding * result = find(sym);
+	if ((result != nullptr) && (result->type == ProcedureBiType)) {
+		return result->proc_bi;
 	}
 
 	return default_proc_bi;
 }
 
-bool Environment::is_proc_prop(const Atom & sym) const {
-	if (!sym.isSymbol()) return false;
-
-	auto result = envmap.find(sym.asSymbol());
-	return (result != envmap.end()) && (result->second.type == ProcedurePropType);
-}
-
-Procedure_prop Environment::get_proc_prop(const Atom &sym) const {
-
-	if (sym.isSymbol()) {
-		auto result = envmap.find(sym.asSymbol());
-		if ((result != envmap.end()) && (result->second.type == ProcedurePropType)) {
-			return result->second.proc_prop;
-		}
-	}
-
-	return default_proc_prop;
-}
-
 const double PI = std::atan2(0, -1);
 const double EXP = std::exp(1);
 const std::complex<double> I(0.0, 1.0);
 
 /*
-Reset the environment to the default state. First remove all entries and
-then re-add the default ones.
+Reset the environment to the default state. The built-ins are not stored in
+the environment, so this only removes the entries it added.
  */
 void Environment::reset() {
 
-	envmap.clear();
+	bindings.clear();
+	locals.clear();
+}
+
+/*
+Build the table of built-ins, then search for a perfect hash over them.
+ */
+BuiltinTable::BuiltinTable() {
 
 	// Built-In value of pi
-	envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
+	define("pi", Environment::Binding(Expression(PI)));
 
 	// Built-In value of euler's number
-	envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
+	define("e", Environment::Binding(Expression(EXP)));
 
 	// Built-In value of euler's number
-	envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
+	define("I", Environment::Binding(Expression(I)));
 
 	// Procedure: add;
-	envmap.emplace("+", EnvResult(ProcedureType, add));
+	define("+", Environment::Binding(add));
 
 	// Procedure: subneg;
-	envmap.emplace("-", EnvResult(ProcedureType, subneg));
+	define("-", Environment::Binding(subneg));
 
 	// Procedure: mul;
-	envmap.emplace("*", EnvResult(ProcedureType, mul));
+	define("*", Environment::Binding(mul));
 
 	// Procedure: div;
-	envmap.emplace("/", EnvResult(ProcedureType, div));
+	define("/", Environment::Binding(div));
 
 	// Procedure: sqrt;
-	envmap.emplace("sqrt", EnvResult(ProcedureType, sqrt));
+	define("sqrt", Environment::Binding(sqrt));
 
 	// Procedure: pow;
-	envmap.emplace("^", EnvResult(ProcedureType, pow));
+	define("^", Environment::Binding(pow));
 
 	// Procedure: ln;
-	envmap.emplace("ln", EnvResult(ProcedureType, ln));
+	define("ln", Environment::Binding(ln));
 
 	// Procedure: sin;
-	envmap.emplace("sin", EnvResult(ProcedureType, sin));
+	define("sin", Environment::Binding(sin));
 
 	// Procedure: cos;
-	envmap.emplace("cos", EnvResult(ProcedureType, cos));
+	define("cos", Environment::Binding(cos));
 
 	// Procedure: tan;
-	envmap.emplace("tan", EnvResult(ProcedureType, tan));
+	define("tan", Environment::Binding(tan));
 
 	// Procedure: real;
-	envmap.emplace("real", EnvResult(ProcedureType, real));
+	define("real", Environment::Binding(real));
 
 	// Procedure: imag;
-	envmap.emplace("imag", EnvResult(ProcedureType, imag));
+	define("imag", Environment::Binding(imag));
 
 	// Procedure: mag;
-	envmap.emplace("mag", EnvResult(ProcedureType, mag));
+	define("mag", Environment::Binding(mag));
 
 	// Procedure: arg;
-	envmap.emplace("arg", EnvResult(ProcedureType, arg));
+	define("arg", Environment::Binding(arg));
 
 	// Procedure: conj;
-	envmap.emplace("conj", EnvResult(ProcedureType, conj));
+	define("conj", Environment::Binding(conj));
 
 	// Procedure: list;
-	envmap.emplace("list", EnvResult(ProcedureType, list));
+	define("list", Environment::Binding(list));
 
 	// Procedure: first;
-	envmap.emplace("first", EnvResult(ProcedureType, first));
+	define("first", Environment::Binding(first));
 
 	// Procedure: rest;
-	envmap.emplace("rest", EnvResult(ProcedureType, rest));
+	define("rest", Environment::Binding(rest));
 
 	// Procedure: length;
-	envmap.emplace("length", EnvResult(ProcedureType, length));
+	define("length", Environment::Binding(length));
 
 	// Procedure: append;
-	envmap.emplace("append", EnvResult(ProcedureType, append));
+	define("append", Environment::Binding(append));
 
 	// Procedure: join;
-	envmap.emplace("join", EnvResult(ProcedureType, join));
+	define("join", Environment::Binding(join));
 
 	// Procedure: range;
-	envmap.emplace("range", EnvResult(ProcedureType, range));
+	define("range", Environment::Binding(range));
 
 	// Procedure: discrete-plot;
-	envmap.emplace("discrete-plot", EnvResult(ProcedurePropType, discrete_plot));
+	define("discrete-plot", Environment::Binding(discrete_plot));
 
 	// Procedure: continuous-plot;
-	envmap.emplace("continuous-plot", EnvResult(ProcedureBiType, continuous_plot));
+	define("continuous-plot", Environment::Binding(continuous_plot));
 
 	// Binary Procedure: apply;
-	envmap.emplace("apply", EnvResult(ProcedureBiType, apply));
+	define("apply", Environment::Binding(apply));
 
 	// Binary Procedure: map;
-	envmap.emplace("map", EnvResult(ProcedureBiType, map));
+	define("map", Environment::Binding(map));
+
+	// Binary Procedure: pmap;
+	define("pmap", Environment::Binding(pmap));
 
 	// Binary Procedure: set-property;
-	envmap.emplace("set-property", EnvResult(ProcedurePropType, set_property));
+	define("set-property", Environment::Binding(set_property));
 
 	// Binary Procedure: get-property;
-	envmap.emplace("get-property", EnvResult(ProcedurePropType, get_property));
+	define("get-property", Environment::Binding(get_property));
+
+	// table sizes grow until a multiplier that separates every built-in is
+	// found; a sparse table needs only a few tries
+	std::uint64_t candidate = 0x9E3779B97F4A7C15ull;
+	for (mask = 1; mask + 1 < 4 * keys.size(); mask = 2 * mask + 1) {}
+	while (true) {
+		for (int attempt = 0; attempt < 1000; ++attempt) {
+			seed = candidate;
+			if (place()) return;
+			// the next odd multiplier from a 64-bit LCG
+			candidate = (candidate * 6364136223846793005ull + 1442695040888963407ull) | 1;
+		}
+		mask = 2 * mask + 1;
+	}
 }
@@ -11,24 +11,30 @@ needed.
 #define ENVIRONMENT_HPP
 
 // system includes
-#include <map>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
 
 // module includes
+#include "arena.hpp"
 #include "atom.hpp"
 #include "expression.hpp"
+#include "interrupt.hpp"
 
 /*! \typedef Procedure
 \brief A Procedure is a C++ function pointer taking a vector of 
        Expressions as arguments and returning an Expression.
-*/
-//Procedure is a built in plotscript functin type requiring a const reference to a vector of Expressions to evaluate
-typedef Expression (*Procedure)(const std::vector<Expression> & args);
 
-//Procedure_prop is a plot-type built in procedure where the arguments are not-const in order to edit their values
-typedef Expression(*Procedure_prop)(std::vector<Expression> & args);
+The procedure owns the arguments: it may modify them or move from them,
+including taking the vector's buffer, so the caller must not use args
+after the call.
+*/
+//Procedure is a built in plotscript functin type taking the vector of Expressions to evaluate
+typedef Expression (*Procedure)(std::vector<Expression> & args);
 
-//Procedure_bi is a plotscript function that requires access to the environment
-typedef Expression (*Procedure_bi)(const std::vector<Expression> & args, Environment & env);
+//Procedure_bi is a plotscript function that requires access to the environment, and owns args as a Procedure does
+typedef Expression (*Procedure_bi)(std::vector<Expression> & args, Environment & env);
 
 /*! \class Environment
 \brief A class representing the interpreter environment.
@@ -36,13 +42,26 @@ typedef Expression (*Procedure_bi)(const std::vector<Expression> & args, Environ
 An instance of Environment allows the interpreter to track previously defined
 procedures and definitions, either built-in or defined during execution.
 
-To lookup a symbol use one of the member functions is_exp or is_proc, or if you
+To lookup a symbol use find, which returns everything the symbol maps to in
+one search, or one of the member functions is_exp or is_proc, or if you
 do not care about
 what the symbol maps to is_known. Depending on the value these member functions
 return you can obtain
 the mapped-to value using get_exp or get_proc.
 
+Bindings are kept in a flat open-addressing table keyed by interned symbol,
+so each frame is searched with a single probe in the common case. The
+built-in procedures and values are not copied into environments: they live
+in one static table, shared by every environment, that is searched after
+the outermost frame.
+
 To add an symbol to expression mapping use the add_exp member function.
+
+An Environment may also be a scope frame linked to a parent environment. A
+frame only stores its own bindings (e.g. the parameters of a lambda call);
+any symbol it does not bind is looked up in the parent, so creating a frame
+costs time proportional to the bindings added to it, not to the size of the
+parent.
  */
 class Environment {
 public:
@@ -52,6 +71,58 @@ public:
 
   Environment(const Environment & env);
 
+  /*! Construct an empty scope frame chained to a parent environment. A
+    frame constructed while an ArenaScope is open allocates from the arena,
+    and must be destroyed before the scope closes.
+    \param parent the enclosing environment, must outlive the frame
+   */
+  explicit Environment(const Environment * parent);
+
+  /*! Construct an environment forked from a snapshot (see snapshot). It
+    starts with every binding of the snapshot, shared rather than copied, so
+    forking takes constant time. Its own definitions, and reset, never
+    change the snapshot.
+    \param snapshot the snapshot to fork, kept alive by the environment
+   */
+  explicit Environment(std::shared_ptr<const Environment> snapshot);
+
+  /*! Capture the bindings of this environment as an immutable snapshot.
+    Any number of environments, on any threads, can then fork from it.
+    \return the snapshot
+   */
+  std::shared_ptr<const Environment> snapshot() const;
+
+  /// The kind of value a symbol can map to
+  enum BindingType { ExpressionType, ProcedureType, ProcedureBiType };
+
+  /*! \struct Binding
+  \brief The value a symbol maps to, tagged by its type.
+   */
+  struct Binding {
+    BindingType type;
+    Expression exp; // used when type is ExpressionType
+    union {
+      Procedure proc; // used when type is ProcedureType
+      Procedure_bi proc_bi; // used when type is ProcedureBiType
+    };
+
+    Binding(): type(ExpressionType), proc(nullptr) {}
+    Binding(const Expression & e): type(ExpressionType), exp(e), proc(nullptr) {}
+    Binding(Procedure p): type(ProcedureType), proc(p) {}
+    Binding(Procedure_bi pb): type(ProcedureBiType), proc_bi(pb) {}
+
+    /// true if the symbol names a built-in procedure of any kind
+    bool isProcedure() const noexcept { return type != ExpressionType; }
+  };
+
+  /*! Find what a symbol maps to, searching this frame, then its parents,
+    then the built-ins.
+    \param sym the symbol to lookup
+    \return the binding, or nullptr if the symbol is not known. It is valid
+    until the next add_exp or reset of the frame that holds it.
+   */
+  const Binding * find(const Atom &sym) const;
+
   /*! Determine if a symbol is known to the environment.
     \param sym the sumbol to lookup
     \return true if the symbol has been defined in the environment
@@ -74,7 +145,9 @@ public:
   /*! Add a mapping from sym argument to the exp argument within the environment.
     \param sym the symbol to add
     \param exp the expression the symbol should map to
-	\param lambdaFlag flag to notify the function if a lambda function is being evaluated so that it can overwrite a value
+	\param lambdaFlag flag to notify the function if a lambda function is being evaluated so that it can overwrite a value.
+	Parameters are kept in slots numbered in the order they are first bound,
+	and binding one again reuses its slot.
    */
   void add_exp(const Atom &sym, const Expression &exp, bool lambdaFlag);
 
@@ -108,47 +181,76 @@ public:
   */
   Procedure_bi get_proc_bi(const Atom &sym) const;
 
-  /*! Determine if a symbol has been defined as a property procedure
-  \param sym the symbol to lookup
-  \return true if thr symbol maps to a procedure_bi
-  */
-  bool is_proc_prop(const Atom &sym) const;
-
-  /*! Get the PRocedure_prop the argument symbol maps to
-  \param sym the symbol to lookup
-  \return the procedure_bi it maps to
+  /*! Reset the environment to its default state. A scope frame only drops
+    its own bindings. */
+  void reset();
 
-  Note: return the default procedure_prop if argument is not a symbol
-  or does not map to a known procedure_prop.
-  */
-  Procedure_prop get_proc_prop(const Atom &sym) const;
+  /*! Set the Interrupt polled by check_interrupt. Scope frames created
+    afterwards share it with their parent.
+    \param flag the interrupt to poll, or nullptr for none
+   */
+  void set_interrupt(const Interrupt * flag) noexcept;
 
-  /*! Reset the environment to its default state. */
-  void reset();
+  /// throw a SemanticError if the Interrupt has been requested
+  void check_interrupt() const {
+    if(interrupt != nullptr) interrupt->check();
+  }
 
 private:
   
-  // Environment is a mapping from symbols to expressions or procedures
-  enum EnvResultType { ExpressionType, ProcedureType, ProcedureBiType, ProcedurePropType};
+  /* A flat open-addressing hash table from interned symbols to bindings,
+     with linear probing. Symbols are never removed except all at once by
+     clear, so no tombstones are needed. */
+  class BindingTable {
+  public:
+    BindingTable() noexcept: count(0) {}
+
+    // the binding of key, or nullptr
+    const Binding * find(SymbolId key) const noexcept;
+
+    // the binding of key, added as a default Binding if missing
+    Binding & insert(SymbolId key);
+
+    // remove every binding, keeping the storage
+    void clear() noexcept;
+
+    // call f with each binding
+    template <typename F> void for_each(F f) const {
+      for(const Slot & slot : slots){
+        if(slot.key != nullptr) f(slot.value);
+      }
+    }
+
+  private:
+    struct Slot {
+      SymbolId key; // nullptr when the slot is empty
+      Binding value;
+    };
+
+    // the capacity is zero or a power of two, at most half full
+    std::vector<Slot> slots;
+    std::size_t count;
+
+    void grow();
+  };
 
-  struct EnvResult {
-    EnvResultType type;
-    Expression exp; // used when type is ExpressionType
-    Procedure proc; // used when type is ProcedureType
-	Procedure_bi proc_bi; //used when type is ProcedureBiType
-	Procedure_prop proc_prop; 
+  // the bindings of this frame
+  BindingTable bindings;
 
-    // constructors for use in container emplace
-    EnvResult(){};
-    EnvResult(EnvResultType t, Expression e) : type(t), exp(e){};
-    EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
-	EnvResult(EnvResultType t, Procedure_bi pb) : type(t), proc_bi(pb) {};
-	EnvResult(EnvResultType t, Procedure_prop pp) : type(t), proc_prop(pp) {};
+  // the lambda parameters bound in this frame, in the order first bound, so
+  // that the slots given by Expression::resolve index them directly. A
+  // scope frame made during an evaluation keeps them in the thread's Arena
+  typedef std::pair<SymbolId, Binding> Local;
+  std::vector<Local, ArenaAllocator<Local>> locals;
 
-  };
+  // enclosing scope searched when a symbol is not bound here, or nullptr
+  const Environment * parent;
+
+  // the snapshot this environment was forked from, which is its parent
+  std::shared_ptr<const Environment> base;
 
-  // the environment map
-  std::map<std::string, EnvResult> envmap;
+  // the interrupt polled during evaluation, or nullptr
+  const Interrupt * interrupt;
 };
 
 #endif
@@ -69,6 +69,46 @@ TEST_CASE( "Test get built-in procedure", "[environment]" ) {
   REQUIRE(padd(args) == Expression(3.0));
 }
 
+TEST_CASE( "Test find", "[environment]" ) {
+  Environment env;
+
+  INFO("built-ins are found with their kind")
+  REQUIRE(env.find(Atom("+")) != nullptr);
+  REQUIRE(env.find(Atom("+"))->type == Environment::ProcedureType);
+  REQUIRE(env.find(Atom("map"))->type == Environment::ProcedureBiType);
+  REQUIRE(env.find(Atom("get-property"))->type == Environment::ProcedureType);
+  REQUIRE(env.find(Atom("pi"))->type == Environment::ExpressionType);
+  REQUIRE(env.find(Atom("pi"))->exp == Expression(std::atan2(0, -1)));
+
+  INFO("unknown symbols and non-symbols are not found")
+  REQUIRE(env.find(Atom("doesnotexist")) == nullptr);
+  REQUIRE(env.find(Atom(1.0)) == nullptr);
+
+  INFO("many bindings are all found after the table grows")
+  for(int i = 0; i < 10000; ++i){
+    env.add_exp(Atom("x" + std::to_string(i)), Expression(double(i)), false);
+  }
+  bool found = true;
+  for(int i = 0; i < 10000; ++i){
+    const Environment::Binding * b = env.find(Atom("x" + std::to_string(i)));
+    found = found && (b != nullptr) && (b->exp == Expression(double(i)));
+  }
+  REQUIRE(found);
+  REQUIRE(env.is_proc(Atom("+")));
+
+  INFO("a parameter shadows a built-in and rebinds in place")
+  Environment frame(&env);
+  frame.add_exp(Atom("+"), Expression(1.0), true);
+  frame.add_exp(Atom("+"), Expression(2.0), true);
+  REQUIRE(frame.find(Atom("+"))->exp == Expression(2.0));
+  REQUIRE(env.find(Atom("+"))->isProcedure());
+
+  INFO("reset keeps the built-ins")
+  env.reset();
+  REQUIRE(env.find(Atom("x0")) == nullptr);
+  REQUIRE(env.is_proc(Atom("+")));
+}
+
 TEST_CASE( "Test reset", "[environment]" ) {
   Environment env;
 
@@ -97,3 +137,69 @@ TEST_CASE( "Test semeantic errors", "[environment]" ) {
   }
 }
 
+
+TEST_CASE( "Test scope frame", "[environment]" ) {
+
+  Environment env;
+  env.add_exp(Atom("x"), Expression(1.0), false);
+
+  Environment frame(&env);
+  REQUIRE(frame.is_proc(Atom("+")));
+  REQUIRE(frame.get_exp(Atom("x")) == Expression(1.0));
+
+  // parameters shadow the parent without touching it
+  frame.add_exp(Atom("x"), Expression(2.0), true);
+  frame.add_exp(Atom("y"), Expression(3.0), true);
+  REQUIRE(frame.get_exp(Atom("x")) == Expression(2.0));
+  REQUIRE(env.get_exp(Atom("x")) == Expression(1.0));
+  REQUIRE(!env.is_known(Atom("y")));
+
+  // resetting a frame only drops its own bindings
+  frame.reset();
+  REQUIRE(frame.get_exp(Atom("x")) == Expression(1.0));
+  REQUIRE(!frame.is_known(Atom("y")));
+  REQUIRE(frame.is_proc(Atom("+")));
+}
+
+TEST_CASE( "Test snapshot and fork", "[environment]" ) {
+
+  std::shared_ptr<const Environment> snapshot;
+  {
+    Environment env;
+    env.add_exp(Atom("x"), Expression(1.0), false);
+    env.add_exp(Atom("xs"), Expression(std::vector<double>{1, 2, 3}), false);
+    snapshot = env.snapshot();
+
+    // later changes to the original do not reach the snapshot
+    env.add_exp(Atom("z"), Expression(4.0), false);
+  }
+  REQUIRE(!snapshot->is_known(Atom("z")));
+
+  Environment first(snapshot);
+  Environment second(snapshot);
+  REQUIRE(first.is_proc(Atom("+")));
+  REQUIRE(first.get_exp(Atom("x")) == Expression(1.0));
+  REQUIRE(first.get_exp(Atom("xs")).tailLength() == 3);
+
+  // definitions stay in the fork that made them
+  first.add_exp(Atom("y"), Expression(2.0), false);
+  REQUIRE(first.get_exp(Atom("y")) == Expression(2.0));
+  REQUIRE(!second.is_known(Atom("y")));
+  REQUIRE(!snapshot->is_known(Atom("y")));
+
+  // a define still never overwrites a symbol from the snapshot
+  first.add_exp(Atom("x"), Expression(5.0), false);
+  REQUIRE(first.get_exp(Atom("x")) == Expression(1.0));
+
+  // reset returns a fork to the snapshot
+  first.reset();
+  REQUIRE(!first.is_known(Atom("y")));
+  REQUIRE(first.get_exp(Atom("x")) == Expression(1.0));
+  REQUIRE(first.is_proc(Atom("+")));
+
+  // a fork can itself be snapshotted and forked
+  second.add_exp(Atom("w"), Expression(6.0), false);
+  Environment third(second.snapshot());
+  REQUIRE(third.get_exp(Atom("w")) == Expression(6.0));
+  REQUIRE(third.get_exp(Atom("x")) == Expression(1.0));
+}
@@ -1,12 +1,24 @@
 #include "expression.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <functional>
 #include <sstream>
+#include <stdexcept>
 #include <list>
 #include <iostream>
 
+#include "arena.hpp"
 #include "environment.hpp"
 #include "semantic_error.hpp"
 
+// interned symbols of the special forms, compared by handle during eval
+static const Atom LIST_SYMBOL("list");
+static const Atom LAMBDA_SYMBOL("lambda");
+static const Atom BEGIN_SYMBOL("begin");
+static const Atom DEFINE_SYMBOL("define");
 
 Expression::Expression(){}
 
@@ -16,44 +28,212 @@ Expression::Expression(const Atom & a){
 }
 
 Expression::Expression(const std::vector<Expression> & args) {
-	m_head = Atom("list");
-	m_tail = args;
+	m_head = LIST_SYMBOL;
+	if (!args.empty()) {
+		m_tail = std::make_shared<std::vector<Expression>>(args);
+	}
+}
+
+Expression::Expression(std::vector<Expression> && args) {
+	m_head = LIST_SYMBOL;
+	if (!args.empty()) {
+		m_tail = std::make_shared<std::vector<Expression>>(std::move(args));
+	}
+}
+
+Expression::Expression(const std::vector<double> & values) {
+	m_head = LIST_SYMBOL;
+	if (!values.empty()) {
+		m_packed = std::make_shared<PackedTail>();
+		m_packed->numbers = values;
+	}
+}
+
+Expression::Expression(std::vector<double> && values) {
+	m_head = LIST_SYMBOL;
+	if (!values.empty()) {
+		m_packed = std::make_shared<PackedTail>();
+		m_packed->numbers = std::move(values);
+	}
+}
+
+Expression::Expression(const std::vector<std::complex<double>> & values) {
+	m_head = LIST_SYMBOL;
+	if (!values.empty()) {
+		m_packed = std::make_shared<PackedTail>();
+		m_packed->complex = true;
+		m_packed->complexes = values;
+	}
+}
+
+Expression::Expression(std::vector<std::complex<double>> && values) {
+	m_head = LIST_SYMBOL;
+	if (!values.empty()) {
+		m_packed = std::make_shared<PackedTail>();
+		m_packed->complex = true;
+		m_packed->complexes = std::move(values);
+	}
+}
+
+// true if e can live in a PackedTail: a bare Number or Complex
+static bool isPlainNumeric(const Expression & e) {
+	return (e.isHeadNumber() || e.isHeadComplex()) && e.tailLength() == 0 && e.getPropertyList().empty();
+}
+
+// the packed form of a list of plain Numbers or plain Complex values, or
+// false if args has any other element
+static bool packList(const std::vector<Expression> & args, Expression & packed) {
+
+	bool numbers = !args.empty();
+	bool complexes = !args.empty();
+	for (const auto & a : args) {
+		if (!isPlainNumeric(a)) {
+			return false;
+		}
+		numbers = numbers && a.isHeadNumber();
+		complexes = complexes && a.isHeadComplex();
+	}
+
+	if (numbers) {
+		std::vector<double> values;
+		values.reserve(args.size());
+		for (const auto & a : args) {
+			values.push_back(a.head().asNumber());
+		}
+		packed = Expression(std::move(values));
+		return true;
+	}
+	else if (complexes) {
+		std::vector<std::complex<double>> values;
+		values.reserve(args.size());
+		for (const auto & a : args) {
+			values.push_back(a.head().asComplex());
+		}
+		packed = Expression(std::move(values));
+		return true;
+	}
+
+	return false;
+}
+
+Expression Expression::makeList(const std::vector<Expression> & args) {
+
+	Expression packed;
+	if (packList(args, packed)) {
+		return packed;
+	}
+
+	return Expression(args);
+}
+
+Expression Expression::makeList(std::vector<Expression> && args) {
+
+	Expression packed;
+	if (packList(args, packed)) {
+		return packed;
+	}
+
+	return Expression(std::move(args));
 }
 
 Expression::Expression(const Expression & tail0, const Expression & tail1) {
-	std::vector<Expression> tail;
-	tail.push_back(tail0);
-	tail.push_back(tail1);
+	m_tail = std::make_shared<std::vector<Expression>>();
+	m_tail->push_back(tail0);
+	m_tail->push_back(tail1);
 
-	m_head = Atom("lambda");
-	m_tail = tail;
+	m_head = LAMBDA_SYMBOL;
 }
 
-// recursive copy
-Expression::Expression(const Expression & a){
+// shallow copy, the tail and properties are shared until written
+Expression::Expression(const Expression & a) noexcept:
+  m_head(a.m_head), m_tail(a.m_tail), m_packed(a.m_packed), property_list(a.property_list) {}
 
-  m_head = a.m_head;
-  property_list = a.property_list;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
-  }
+Expression::Expression(Expression && a) noexcept:
+  m_head(a.m_head), m_tail(std::move(a.m_tail)), m_packed(std::move(a.m_packed)),
+  property_list(std::move(a.property_list)) {
+  a.m_head = Atom();
 }
 
 Expression & Expression::operator=(const Expression & a){
 
   // prevent self-assignment
   if(this != &a){
+    // a may be part of the old tail, so release it only after copying
+    std::shared_ptr<std::vector<Expression>> old = m_tail;
     m_head = a.m_head;
-	property_list = a.property_list;
-    m_tail.clear();
-    for(auto e : a.m_tail){
-      m_tail.push_back(e);
-    } 
+    m_tail = a.m_tail;
+    m_packed = a.m_packed;
+    property_list = a.property_list;
+    releaseTail(old);
   }
   
   return *this;
 }
 
+Expression & Expression::operator=(Expression && a) noexcept{
+
+  if(this != &a){
+    // a may be part of the old tail, so release it only after moving
+    std::shared_ptr<std::vector<Expression>> old = std::move(m_tail);
+    m_head = a.m_head;
+    m_tail = std::move(a.m_tail);
+    m_packed = std::move(a.m_packed);
+    property_list = std::move(a.property_list);
+    a.m_head = Atom();
+    releaseTail(old);
+  }
+
+  return *this;
+}
+
+// Dropping the last reference to a deep tree would destroy it recursively,
+// one native stack frame per level. Instead uniquely owned tails are
+// unlinked onto a worklist and destroyed one level at a time.
+void Expression::releaseTail(std::shared_ptr<std::vector<Expression>> & tail){
+
+  if(!tail || tail.use_count() != 1) return;
+
+  // the common case: no child owns a tail, plain destruction is shallow
+  bool deep = false;
+  for(const auto & e : *tail){
+    if(e.m_tail && e.m_tail.use_count() == 1){
+      deep = true;
+      break;
+    }
+  }
+  if(!deep) return;
+
+  std::vector<std::shared_ptr<std::vector<Expression>>> pending;
+  pending.push_back(std::move(tail));
+  while(!pending.empty()){
+    std::shared_ptr<std::vector<Expression>> next = std::move(pending.back());
+    pending.pop_back();
+    for(auto & e : *next){
+      if(e.m_tail && e.m_tail.use_count() == 1){
+        pending.push_back(std::move(e.m_tail));
+      }
+    }
+  }
+}
+
+std::vector<Expression> & Expression::mutableTail(){
+
+  if(m_packed){
+    // writing through the tail unpacks the list for good
+    m_tail = std::make_shared<std::vector<Expression>>(m_packed->elements());
+    m_packed.reset();
+  }
+
+  if(!m_tail){
+    m_tail = std::make_shared<std::vector<Expression>>();
+  }
+  else if(m_tail.use_count() > 1){
+    m_tail = std::make_shared<std::vector<Expression>>(*m_tail);
+  }
+
+  return *m_tail;
+}
+
 
 Atom & Expression::head(){
   return m_head;
@@ -86,103 +266,98 @@ bool Expression::isHeadNone() const noexcept {
 }
 
 bool Expression::isHeadLambda() const noexcept {
-	return m_head == Atom("lambda");
+	return m_head == LAMBDA_SYMBOL;
 }
 
 bool Expression::isHeadList() const noexcept {
-	return m_head == Atom("list");
+	return m_head == LIST_SYMBOL;
 }
 
 void Expression::append(const Atom & a){
-  m_tail.emplace_back(a);
+  append(Expression(a));
 }
 
 void Expression::append(const Expression & e) {
-	m_tail.push_back(e);
+
+	// stay packed when e is a value of the packed kind
+	if (m_packed && isPlainNumeric(e) && (e.isHeadComplex() == m_packed->complex)) {
+		if (m_packed.use_count() > 1) {
+			m_packed = std::make_shared<PackedTail>(*m_packed);
+		}
+		if (m_packed->complex) {
+			m_packed->complexes.push_back(e.head().asComplex());
+		}
+		else {
+			m_packed->numbers.push_back(e.head().asNumber());
+		}
+		return;
+	}
+
+	mutableTail().push_back(e);
+}
+
+void Expression::append(Expression && e) {
+
+	if (m_packed) {
+		append(static_cast<const Expression &>(e));
+		return;
+	}
+
+	mutableTail().push_back(std::move(e));
 }
 
 
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
   
-  if(m_tail.size() > 0){
-    ptr = &m_tail.back();
+  if(tailLength() > 0){
+    ptr = &mutableTail().back();
   }
 
   return ptr;
 }
 
 Expression::ConstIteratorType Expression::tailConstBegin() const noexcept{
-  return m_tail.cbegin();
+  return getTail().cbegin();
 }
 
 Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
-  return m_tail.cend();
+  return getTail().cend();
 }
 
 
-Expression apply(const Atom & op, const std::vector<Expression> & args,  Environment & env){
+// call the built-in procedure op, found as binding; lambda calls are handled by eval
+static Expression apply(const Atom & op, const Environment::Binding * binding,
+                        std::vector<Expression> & args,  Environment & env){
 
   // head must be a symbol
   if(!op.isSymbol()){
     throw SemanticError("Error during evaluation: procedure name not symbol");
   }
 
-  if (env.is_exp(op)) {
-	  //get the lambda expression
-	  Expression lambdaExp = env.get_exp(op);
-	  //create new environment
-	  Environment newEnv = Environment(env);
-
-	  //get the list of parameter symbols
-	  std::vector<Expression> params = lambdaExp.getTail().at(0).getTail();
-
-	  //if the size of the arguments and the size of the inputs dont match throw an error
-	  if (params.size() != args.size()) {
-		  throw SemanticError("Error during evaluation: lambda function called with incorrect number of args");
-	  }
-
-
-	  //save the inputs as known expressions
-	  for (size_t i = 0; i < params.size(); i++) {
-		  newEnv.add_exp(params[i].head(), args[i], true);
-	  }
-
-	  //return the evaluation
-	  return lambdaExp.getTail().at(1).eval(newEnv);
-  }
-  else if (env.is_proc(op)) {
-	  // map from symbol to proc
-	  Procedure proc = env.get_proc(op);
-	  // call proc with args
-	  return proc(args);
-  }
-  else if (env.is_proc_bi(op)){
-		  // map from symbol to binary proc
-		  Procedure_bi proc_bi = env.get_proc_bi(op);
-		  // call proc_bi with args
-		  return proc_bi(args, env);
+  if (binding == nullptr || !binding->isProcedure()) {
+	  throw SemanticError("Error during evaluation: symbol does not name a procedure");
   }
-  else if (env.is_proc_prop(op)) {
-	  // map from symbol to property proc
-	  Procedure_prop proc_prop = env.get_proc_prop(op);
+
+  switch (binding->type) {
+  case Environment::ProcedureBiType:
 	  // call proc_bi with args
-	  std::vector<Expression> nonConstArgs = args;
-	  return proc_prop(nonConstArgs);
+	  return binding->proc_bi(args, env);
+  default:
+	  // call proc with args
+	  return binding->proc(args);
   }
-  else
-	  throw SemanticError("Error during evaluation: symbol does not name a procedure");
-
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const{
     if(head.isSymbol())
 	{ // if symbol is in env return value
-      if(env.is_exp(head))
+      const Environment::Binding * binding = env.find(head);
+      if(binding != nullptr && !binding->isProcedure())
 	  {
-		return env.get_exp(head);
+		return binding->exp;
       }
-	  else if (env.is_proc(head) || env.is_proc_bi(head) || env.is_proc_prop(head)) {
+	  else if (binding != nullptr) {
 		  return Expression(head);
 	  }
       else
@@ -198,110 +373,356 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }
 
-Expression Expression::handle_begin(Environment & env){
-  
-  if(m_tail.size() == 0){
-    throw SemanticError("Error during evaluation: zero arguments to begin");
-  }
-
-  // evaluate each arg from tail, return the last
-  Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
-    result = it->eval(env);
-  }
-  
-  return result;
-}
-
+void Expression::check_define(const Environment & env) const {
 
-Expression Expression::handle_define(Environment & env) {
+	const std::vector<Expression> & tail = getTail();
 
 	// tail must have size 3 or error
-	if (m_tail.size() != 2) {
+	if (tail.size() != 2) {
 		throw SemanticError("Error during evaluation: invalid number of arguments to define");
 	}
 
 	// tail[0] must be symbol
-	if (!m_tail[0].isHeadSymbol()) {
+	if (!tail[0].isHeadSymbol()) {
 		throw SemanticError("Error during evaluation: first argument to define not symbol");
 	}
 
 	// but tail[0] must not be a special-form or procedure
-	std::string s = m_tail[0].head().asSymbol();
-	if ((s == "define") || (s == "begin")) {
+	const Atom & s = tail[0].head();
+	if ((s == DEFINE_SYMBOL) || (s == BEGIN_SYMBOL)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
 	}
 
-	if (env.is_proc(m_head) || env.is_proc_bi(m_head) || env.is_proc_prop(m_head)) {
+	const Environment::Binding * binding = env.find(m_head);
+	if (binding != nullptr && binding->isProcedure()) {
 		throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
 	}
-
-	// eval tail[1]
-	Expression result = m_tail[1].eval(env);
-
-	/*if (env.is_exp(m_head)) {
-		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
-	}*/
-
-	//and add to env
-	env.add_exp(m_tail[0].head(), result, false);
-
-	return result;
 }
 
 
-Expression Expression::handle_lambda() {
+Expression Expression::handle_lambda() const {
+
+	const std::vector<Expression> & tail = getTail();
 
 	// tail must have size 2 or error
-	if (m_tail.size() != 2) {
+	if (tail.size() != 2) {
 		throw SemanticError("Error during evaluation: invalid number of arguments to define");
 	}
 
 	//create a vector of parameters as expressions
 	std::vector<Expression> parameters;
 	//push back the head of the first tail member
-	parameters.push_back(m_tail[0].head());
+	parameters.push_back(tail[0].head());
 
 	//for each member of the tail of the first tail member, add to the list of parameters
-	for (auto e = m_tail[0].tailConstBegin(); e != m_tail[0].tailConstEnd(); ++e) {
-		if (e->isHeadSymbol()) {
-			parameters.push_back(*e);
+	//(a packed list, as from an AST cache, holds only numbers and so no parameters)
+	if (!tail[0].packed()) {
+		for (auto e = tail[0].tailConstBegin(); e != tail[0].tailConstEnd(); ++e) {
+			if (e->isHeadSymbol()) {
+				parameters.push_back(*e);
+			}
 		}
 	}
 
 	Expression retExpTail0(parameters);
-	Expression retExpTail1 = m_tail[1];
+	Expression retExpTail1 = tail[1];
 
 	return Expression(retExpTail0, retExpTail1);
 }
 
-// this is a simple recursive version. the iterative version is more
-// difficult with the ast data structure used (no parent pointer).
-// this limits the practical depth of our AST
-Expression Expression::eval(Environment & env) {
+// Scoping is dynamic, so the only symbols whose binding can be located before
+// evaluation are the parameters a lambda body refers to: the body always runs
+// in a frame holding exactly those parameters, bound in order. Each such
+// reference gets the slot of its parameter, numbered among the lambda's
+// distinct parameters as Environment::add_exp numbers them. Any other symbol
+// is left to be looked up at run time, including a nested lambda's references
+// to the outer parameters, since those depend on where the nested lambda is
+// called from.
+void Expression::resolve() {
+
+	// the parameters of each lambda found, in stable storage
+	std::deque<std::vector<SymbolId>> scopes;
+
+	// nodes still to visit, with the parameters of their innermost lambda
+	std::vector<std::pair<Expression *, const std::vector<SymbolId> *>> pending;
+	pending.emplace_back(this, nullptr);
+
+	while (!pending.empty()) {
+		Expression & exp = *pending.back().first;
+		const std::vector<SymbolId> * params = pending.back().second;
+		pending.pop_back();
+
+		if (exp.m_head.isSymbol()) {
+			std::uint32_t slot = Atom::NO_SLOT;
+			if (params != nullptr) {
+				auto param = std::find(params->begin(), params->end(), exp.m_head.asSymbolId());
+				if (param != params->end()) slot = param - params->begin();
+			}
+			exp.m_head.setSlot(slot);
+		}
+
+		// packed lists hold no symbols
+		if (exp.m_packed || exp.tailLength() == 0) {
+			continue;
+		}
 
-	if (m_tail.empty() && m_head != Atom("list")) {
-		return handle_lookup(m_head, env);
+		std::vector<Expression> & tail = exp.mutableTail();
+		if (exp.m_head == LAMBDA_SYMBOL && tail.size() == 2) {
+			// the parameters as handle_lambda collects them
+			scopes.emplace_back();
+			std::vector<SymbolId> & inner = scopes.back();
+			std::vector<const Expression *> names(1, &tail[0]);
+			if (!tail[0].packed()) {
+				for (auto e = tail[0].tailConstBegin(); e != tail[0].tailConstEnd(); ++e) {
+					names.push_back(&*e);
+				}
+			}
+			for (const Expression * name : names) {
+				SymbolId id = name->m_head.asSymbolId();
+				if (name->isHeadSymbol() && std::find(inner.begin(), inner.end(), id) == inner.end()) {
+					inner.push_back(id);
+				}
+			}
+			// the parameter list itself is never evaluated
+			pending.emplace_back(&tail[1], &inner);
+		}
+		else {
+			for (Expression & e : tail) {
+				pending.emplace_back(&e, params);
+			}
+		}
+	}
+}
+
+// A pending evaluation on the continuation stack used by eval
+struct Continuation {
+	Continuation(const Expression * exp, Environment * env) : exp(exp), env(env), next(0), waiting(false) {}
+
+	// the expression being evaluated, and the environment it is evaluated in
+	const Expression * exp;
+	Environment * env;
+
+	// the lambda scope env points to, when this continuation owns it
+	std::shared_ptr<Environment> frame;
+
+	// the lambda whose body exp is part of, keeping it alive
+	Expression lambda;
+
+	// for begin, define and procedure calls the index of the next tail
+	// element to evaluate, and for calls the results so far and whether
+	// value is awaited from the continuation above
+	std::size_t next;
+	std::vector<Expression> args;
+	bool waiting;
+};
+
+// The continuations of one call to eval. Each thread keeps a stack for each
+// level of nested eval calls (built-ins such as map call eval) and finished
+// continuations are kept for reuse, so once warmed up evaluation allocates
+// neither continuations nor argument vectors.
+class ContinuationStack {
+public:
+	// take this thread's stack for a new eval call
+	ContinuationStack() : slots(acquire()), depth(0) {}
+
+	// finish whatever is left, as when an error is thrown, and give the stack back
+	~ContinuationStack() {
+		while (depth > 0) pop();
+		--levels_in_use;
 	}
-	// handle begin special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "begin") {
-		return handle_begin(env);
+
+	// start evaluating exp in env; references to other continuations are
+	// invalidated
+	void push(const Expression * exp, Environment * env) {
+		if (depth == slots.size()) {
+			slots.emplace_back(exp, env);
+		}
+		else {
+			Continuation & k = slots[depth];
+			k.exp = exp;
+			k.env = env;
+			k.next = 0;
+			k.waiting = false;
+		}
+		++depth;
 	}
-	// handle define special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "define") {
-		return handle_define(env);
+
+	// finish the top continuation, releasing what it holds but the capacity
+	// of a small argument vector
+	void pop() {
+		Continuation & k = slots[--depth];
+		k.frame.reset();
+		k.lambda = Expression();
+		if (k.args.capacity() > 64) std::vector<Expression>().swap(k.args);
+		else k.args.clear();
 	}
-	// handle lambda special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "lambda") {
-		return handle_lambda();
+
+	Continuation & top() { return slots[depth - 1]; }
+
+	bool empty() const { return depth == 0; }
+
+private:
+	typedef std::vector<Continuation> Slots;
+
+	Slots & slots;
+	std::size_t depth;
+
+	// the stack of each nesting level, and how many levels are in use
+	static thread_local std::vector<std::unique_ptr<Slots>> levels;
+	static thread_local std::size_t levels_in_use;
+
+	static Slots & acquire() {
+		if (levels_in_use == levels.size()) {
+			levels.emplace_back(new Slots());
+			levels.back()->reserve(16);
+		}
+		return *levels[levels_in_use++];
 	}
-	// else attempt to treat as procedure
-	else {
-		std::vector<Expression> results;
-		for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
-			results.push_back(it->eval(env));
+};
+
+thread_local std::vector<std::unique_ptr<ContinuationStack::Slots>> ContinuationStack::levels;
+thread_local std::size_t ContinuationStack::levels_in_use = 0;
+
+// This is a post-order traversal driven by an explicit stack of
+// continuations on the heap, so the depth of the AST and of nested lambda
+// calls is not limited by the native stack. An expression in tail position
+// (the last of a begin, or a lambda body) replaces the continuation that
+// evaluates it instead of being pushed on top. A lambda called in tail
+// position from another lambda body also takes over its scope frame: the
+// caller's bindings are copied into the callee's frame, which preserves
+// dynamic scoping while letting the caller's frame go. Recursion in tail
+// position therefore runs in constant space.
+Expression Expression::eval(Environment & env) const {
+
+	// scope frames come from the arena, which is released when the
+	// outermost eval returns, after the stack has let go of them
+	ArenaScope scope;
+	Arena * arena = Arena::current();
+
+	ContinuationStack stack;
+	stack.push(this, &env);
+
+	// the result of the continuation most recently finished
+	Expression value;
+
+	while (true) {
+		env.check_interrupt();
+
+		Continuation & k = stack.top();
+		const Expression & exp = *k.exp;
+
+		if (exp.tailLength() == 0 && exp.m_head != LIST_SYMBOL) {
+			value = exp.handle_lookup(exp.m_head, *k.env);
+		}
+		// a packed list holds only values, so it evaluates to itself
+		else if (exp.m_packed) {
+			value = exp;
+		}
+		// handle begin special-form
+		else if (exp.m_head == BEGIN_SYMBOL) {
+			const std::vector<Expression> & tail = exp.getTail();
+			if (tail.empty()) {
+				throw SemanticError("Error during evaluation: zero arguments to begin");
+			}
+			// results other than the last are discarded
+			const Expression * child = &tail[k.next++];
+			if (k.next == tail.size()) {
+				k.exp = child;
+				k.next = 0;
+			}
+			else {
+				stack.push(child, k.env);
+			}
+			continue;
+		}
+		// handle define special-form
+		else if (exp.m_head == DEFINE_SYMBOL) {
+			if (k.next == 0) {
+				exp.check_define(*k.env);
+				k.next = 1;
+				stack.push(&exp.getTail()[1], k.env);
+				continue;
+			}
+			k.env->add_exp(exp.getTail()[0].head(), value, false);
+		}
+		// handle lambda special-form
+		else if (exp.m_head == LAMBDA_SYMBOL) {
+			value = exp.handle_lambda();
+		}
+		// else attempt to treat as procedure
+		else {
+			const std::vector<Expression> & tail = exp.getTail();
+			if (k.waiting) {
+				k.args.push_back(std::move(value));
+				k.waiting = false;
+			}
+			else if (k.next == 0) {
+				k.args.reserve(tail.size());
+			}
+			// terminal arguments are looked up in place, anything else
+			// gets a continuation of its own
+			while (k.next < tail.size()) {
+				const Expression & arg = tail[k.next];
+				if (arg.tailLength() != 0 || arg.m_head == LIST_SYMBOL) {
+					break;
+				}
+				k.args.push_back(arg.handle_lookup(arg.m_head, *k.env));
+				k.next++;
+			}
+			if (k.next < tail.size()) {
+				k.waiting = true;
+				stack.push(&tail[k.next++], k.env);
+				continue;
+			}
+
+			const Atom & op = exp.m_head;
+			const Environment::Binding * binding = k.env->find(op);
+			if (binding != nullptr && !binding->isProcedure()) {
+				//get the lambda expression
+				Expression lambda = binding->exp;
+				if (!lambda.isHeadLambda()) {
+					throw SemanticError("Error during evaluation: symbol does not name a procedure");
+				}
+
+				//get the list of parameter symbols
+				const std::vector<Expression> & params = lambda.getTail().at(0).getTail();
+
+				//if the size of the arguments and the size of the inputs dont match throw an error
+				if (params.size() != k.args.size()) {
+					throw SemanticError("Error during evaluation: lambda function called with incorrect number of args");
+				}
+
+				//create a scope frame for the parameters, everything else is found in env
+				std::shared_ptr<Environment> frame;
+				if (k.frame) {
+					frame = std::allocate_shared<Environment>(ArenaAllocator<Environment>(arena), *k.frame);
+				}
+				else {
+					frame = std::allocate_shared<Environment>(ArenaAllocator<Environment>(arena), k.env);
+				}
+
+				//save the inputs as known expressions
+				for (size_t i = 0; i < params.size(); i++) {
+					frame->add_exp(params[i].head(), k.args[i], true);
+				}
+
+				//continue with the body in place of the call
+				k.lambda = lambda;
+				k.exp = &k.lambda.getTail().at(1);
+				k.env = frame.get();
+				k.frame = frame;
+				k.next = 0;
+				k.args.clear();
+				continue;
+			}
+
+			value = apply(op, binding, k.args, *k.env);
+		}
+
+		stack.pop();
+		if (stack.empty()) {
+			return value;
 		}
-		return apply(m_head, results, env);
 	}
 }
 
@@ -316,19 +737,19 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp) {
 	if (!exp.head().isComplex())
 	{
 		out << "(";
-		if (exp.head() != Atom("list") && exp.head() != Atom("lambda")) {
+		if (!exp.isHeadList() && !exp.isHeadLambda()) {
 			out << exp.head();
 			if (exp.tailLength() > 0) {
 				out << " ";
 			}
 		}
 
-		for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-			if(e == exp.tailConstBegin()){
-				out << *e;
+		for (std::size_t i = 0; i < exp.tailLength(); ++i) {
+			if(i == 0){
+				out << exp.tailAt(i);
 			}
 			else {
-				out << " " << *e;
+				out << " " << exp.tailAt(i);
 			}
 		}
 
@@ -338,8 +759,8 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp) {
 	{
 		out << exp.head();
 
-		for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-			out << *e;
+		for (std::size_t i = 0; i < exp.tailLength(); ++i) {
+			out << exp.tailAt(i);
 		}
 	}
 	
@@ -351,11 +772,37 @@ bool Expression::operator==(const Expression & exp) const noexcept{
 
   bool result = (m_head == exp.m_head);
 
-  result = result && (m_tail.size() == exp.m_tail.size());
+  // a shared tail is trivially equal
+  if((m_tail == exp.m_tail) && (m_packed == exp.m_packed)){
+    return result;
+  }
+
+  // compare packed lists without unpacking them
+  if(m_packed && exp.m_packed && (m_packed->complex == exp.m_packed->complex)){
+    if(!result || (m_packed->size() != exp.m_packed->size())) return false;
+    for(std::size_t i = 0; i < m_packed->size(); ++i){
+      Atom left = m_packed->complex ? Atom(m_packed->complexes[i]) : Atom(m_packed->numbers[i]);
+      Atom right = m_packed->complex ? Atom(exp.m_packed->complexes[i]) : Atom(exp.m_packed->numbers[i]);
+      if(left != right) return false;
+    }
+    return true;
+  }
+
+  result = result && (tailLength() == exp.tailLength());
+
+  // a packed list compared with an unpacked one is read element by element
+  if(result && (m_packed || exp.m_packed)){
+    for(std::size_t i = 0; result && (i < tailLength()); ++i){
+      result = (tailAt(i) == exp.tailAt(i));
+    }
+    return result;
+  }
 
   if(result){
-    for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
+    const std::vector<Expression> & left = getTail();
+    const std::vector<Expression> & right = exp.getTail();
+    for(auto lefte = left.begin(), righte = right.begin();
+	(lefte != left.end()) && (righte != right.end());
 	++lefte, ++righte){
       result = result && (*lefte == *righte);
     }
@@ -374,30 +821,150 @@ bool operator<(const Expression & left, const Expression & right) noexcept {
 	return !(left == right);
 }
 
-//Returns the tail of an expression
-std::vector<Expression> Expression::getTail() const noexcept {
-	return m_tail;
+// shared result for getTail on an empty tail
+static const std::vector<Expression> EMPTY_TAIL;
+
+Expression PackedTail::element(std::size_t i) const {
+	return complex ? Expression(Atom(complexes[i])) : Expression(Atom(numbers[i]));
+}
+
+std::vector<Expression> PackedTail::elements() const {
+	std::vector<Expression> built;
+	built.reserve(size());
+	for (std::size_t i = 0; i < size(); ++i) {
+		built.push_back(element(i));
+	}
+	return built;
+}
+
+//Returns the tail of an unpacked expression; a packed list's elements are only
+//built on request, by tailAt or unpackTail, and never kept. Reading a packed
+//list through here would see it as empty, so callers must check packed first
+const std::vector<Expression> & Expression::getTail() const noexcept {
+	assert(!m_packed && "getTail on a packed list, use tailAt or unpackTail");
+	return m_tail ? *m_tail : EMPTY_TAIL;
+}
+
+Expression Expression::tailAt(std::size_t i) const {
+	if (i >= tailLength()) {
+		throw std::out_of_range("Expression::tailAt");
+	}
+	return m_packed ? m_packed->element(i) : (*m_tail)[i];
+}
+
+std::vector<Expression> Expression::unpackTail() const {
+	if (m_packed) return m_packed->elements();
+	return m_tail ? *m_tail : std::vector<Expression>();
 }
 
 //Returns how many expressions are in the tail of an expression
 size_t Expression::tailLength() const noexcept {
-	return m_tail.size();
+	if (m_packed) return m_packed->size();
+	return m_tail ? m_tail->size() : 0;
+}
+
+const PackedTail * Expression::packed() const noexcept {
+	return m_packed.get();
+}
+
+struct PropertyList::Rep {
+	std::atomic<std::size_t> refs;
+	std::vector<Entry> entries;
+};
+
+PropertyList::PropertyList(const PropertyList & other) noexcept : m_rep(other.m_rep) {
+	if (m_rep) m_rep->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+PropertyList & PropertyList::operator=(const PropertyList & other) noexcept {
+	if (other.m_rep) other.m_rep->refs.fetch_add(1, std::memory_order_relaxed);
+	if (m_rep) release();
+	m_rep = other.m_rep;
+	return *this;
+}
+
+PropertyList & PropertyList::operator=(PropertyList && other) noexcept {
+	if (this != &other) {
+		if (m_rep) release();
+		m_rep = other.m_rep;
+		other.m_rep = nullptr;
+	}
+	return *this;
+}
+
+void PropertyList::release() noexcept {
+	if (m_rep->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete m_rep;
+	}
+	m_rep = nullptr;
+}
+
+// order entries by the address of their interned key
+static bool entryBefore(const PropertyList::Entry & entry, SymbolId key) {
+	return std::less<SymbolId>()(entry.first, key);
+}
+
+const Expression * PropertyList::find(SymbolId key) const noexcept {
+	if (!m_rep) return nullptr;
+	auto it = std::lower_bound(m_rep->entries.begin(), m_rep->entries.end(), key, entryBefore);
+	if (it != m_rep->entries.end() && it->first == key) {
+		return &it->second;
+	}
+	return nullptr;
+}
+
+void PropertyList::set(SymbolId key, const Expression & val) {
+	if (!m_rep) {
+		m_rep = new Rep{ {1}, {} };
+	}
+	else if (m_rep->refs.load(std::memory_order_acquire) > 1) {
+		Rep * copy = new Rep{ {1}, m_rep->entries };
+		release();
+		m_rep = copy;
+	}
+	auto it = std::lower_bound(m_rep->entries.begin(), m_rep->entries.end(), key, entryBefore);
+	if (it != m_rep->entries.end() && it->first == key) {
+		it->second = val;
+	}
+	else {
+		m_rep->entries.insert(it, Entry(key, val));
+	}
 }
 
-Expression Expression::getProperty(std::string key){
-	return property_list[key];
+std::size_t PropertyList::size() const noexcept {
+	return m_rep ? m_rep->entries.size() : 0;
 }
 
+const PropertyList::Entry * PropertyList::begin() const noexcept {
+	return m_rep ? m_rep->entries.data() : nullptr;
+}
+
+const PropertyList::Entry * PropertyList::end() const noexcept {
+	return m_rep ? m_rep->entries.data() + m_rep->entries.size() : nullptr;
+}
+
+Expression Expression::getProperty(SymbolId key) const {
+	const Expression * value = property_list.find(key);
+	return value ? *value : Expression();
+}
+
+Expression Expression::getProperty(const std::string & key) const {
+	return getProperty(intern(key));
+}
+
+void Expression::setProperty(SymbolId key, const Expression & val) {
+	property_list.set(key, val);
+}
 
-void Expression::setProperty(std::string key, Expression val){
-	property_list[key] = val;
+void Expression::setProperty(const std::string & key, const Expression & val){
+	property_list.set(intern(key), val);
 }
 
-void Expression::setPropertyList(std::map<std::string, Expression> map) {
-	property_list = map;
+void Expression::setPropertyList(const PropertyList & list) noexcept {
+	property_list = list;
 }
 
-std::map<std::string, Expression> Expression::getPropertyList() {
+const PropertyList & Expression::getPropertyList() const noexcept {
 	return property_list;
 }
 
@@ -412,19 +979,19 @@ std::string expString(Expression& exp) {
 	if (!exp.head().isComplex())
 	{
 		out << "(";
-		if (exp.head() != Atom("list") && exp.head() != Atom("lambda")) {
+		if (!exp.isHeadList() && !exp.isHeadLambda()) {
 			out << exp.head();
 			if (exp.tailLength() > 0) {
 				out << " ";
 			}
 		}
 
-		for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-			if (e == exp.tailConstBegin()) {
-				out << *e;
+		for (std::size_t i = 0; i < exp.tailLength(); ++i) {
+			if (i == 0) {
+				out << exp.tailAt(i);
 			}
 			else {
-				out << " " << *e;
+				out << " " << exp.tailAt(i);
 			}
 		}
 
@@ -434,8 +1001,8 @@ std::string expString(Expression& exp) {
 	{
 		out << exp.head();
 
-		for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-			out << *e;
+		for (std::size_t i = 0; i < exp.tailLength(); ++i) {
+			out << exp.tailAt(i);
 		}
 	}
 
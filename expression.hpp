@@ -4,10 +4,11 @@ Defines the Expression type and assiciated functions.
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include <atomic>
 #include <string>
 #include <vector>
-#include <map>
-#include <string>
+#include <memory>
+#include <complex>
 
 #include "token.hpp"
 #include "atom.hpp"
@@ -15,11 +16,109 @@ Defines the Expression type and assiciated functions.
 // forward declare Environment
 class Environment;
 
+// forward declare Expression
+class Expression;
+
+
+/*! \struct PackedTail
+\brief Contiguous storage for the tail of a list whose elements are all plain
+Numbers or all plain Complex values (no tail, no properties).
+ */
+struct PackedTail {
+  /// true if the values are in complexes, false if in numbers
+  bool complex = false;
+
+  /// the values of a list of Numbers
+  std::vector<double> numbers;
+
+  /// the values of a list of Complex values
+  std::vector<std::complex<double>> complexes;
+
+  /// number of elements in the list
+  std::size_t size() const noexcept { return complex ? complexes.size() : numbers.size(); }
+
+  /// element i as an Expression
+  Expression element(std::size_t i) const;
+
+  /// every element as an Expression, built afresh on each call
+  std::vector<Expression> elements() const;
+};
+
+/*! \class PropertyList
+\brief The properties of an Expression: pairs of an interned key and a value,
+kept sorted by key.
+
+Most Expressions have no properties, so an empty list is a single null
+pointer and allocates nothing. The entries are reference counted and shared
+between copies, and copied on write by set. Keys are compared as interned
+handles, never as strings.
+ */
+class PropertyList {
+public:
+
+  /// a key and its value
+  typedef std::pair<SymbolId, Expression> Entry;
+
+  /// construct an empty property list
+  PropertyList() noexcept : m_rep(nullptr) {}
+
+  /// copy a property list, sharing its entries
+  PropertyList(const PropertyList & other) noexcept;
+
+  /// move a property list, leaving other empty
+  PropertyList(PropertyList && other) noexcept : m_rep(other.m_rep) { other.m_rep = nullptr; }
+
+  /// copy assign a property list, sharing its entries
+  PropertyList & operator=(const PropertyList & other) noexcept;
+
+  /// move assign a property list, leaving other empty
+  PropertyList & operator=(PropertyList && other) noexcept;
+
+  /// drop this reference to the entries
+  ~PropertyList(){ if(m_rep) release(); }
+
+  /// return the value stored under key, or nullptr
+  const Expression * find(SymbolId key) const noexcept;
+
+  /// store val under key, replacing any value it has
+  void set(SymbolId key, const Expression & val);
+
+  /// true if there are no properties
+  bool empty() const noexcept { return m_rep == nullptr; }
+
+  /// the number of properties
+  std::size_t size() const noexcept;
+
+  /// the entries in key order
+  const Entry * begin() const noexcept;
+  const Entry * end() const noexcept;
+
+private:
+
+  // reference counted entries, null when there are none
+  struct Rep;
+  Rep * m_rep;
+
+  void release() noexcept;
+};
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
 An expression is an atom called the head followed by a (possibly empty) 
 list of expressions called the tail.
+
+The tail and property list are reference counted and shared between copies,
+so copying an Expression is O(1) regardless of the size of the tree. They
+are copied on write: the mutating members (append, tail, setProperty,
+setPropertyList) first take a private copy if the storage is shared.
+
+A list of only Numbers or only Complex values may instead be stored packed
+in a PackedTail (see makeList), which is about ten times smaller and is
+what the numeric list built-ins operate on. A packed list has no tail of
+Expressions: read its elements with tailAt, unpackTail or packed. getTail
+and the tail iterators are only for lists known to be unpacked, and assert
+that they are.
  */
 class Expression {
 public:
@@ -32,6 +131,29 @@ public:
   ///Constructor for creating list type
   Expression(const std::vector<Expression> & args);
 
+  ///Constructor for creating list type, taking the elements' storage
+  Expression(std::vector<Expression> && args);
+
+  ///Constructor for creating a packed list of Numbers
+  Expression(const std::vector<double> & values);
+
+  ///Constructor for creating a packed list of Numbers, taking their storage
+  Expression(std::vector<double> && values);
+
+  ///Constructor for creating a packed list of Complex values
+  Expression(const std::vector<std::complex<double>> & values);
+
+  ///Constructor for creating a packed list of Complex values, taking their storage
+  Expression(std::vector<std::complex<double>> && values);
+
+  /// create a list, packed if every element is a plain Number or every
+  /// element a plain Complex
+  static Expression makeList(const std::vector<Expression> & args);
+
+  /// create a list as makeList does, taking the elements' storage when the
+  /// list is not packed
+  static Expression makeList(std::vector<Expression> && args);
+
   ///Constructor for creating lambda function from two Expressions, the arguments and the function
   Expression(const Expression & tail0, const Expression & tail1);
 
@@ -40,12 +162,21 @@ public:
   */
   Expression(const Atom & a);
 
-  /// deep-copy construct an expression (recursive)
-  Expression(const Expression & a);
+  /// copy construct an expression, sharing its tail and properties
+  Expression(const Expression & a) noexcept;
 
-  /// deep-copy assign an expression  (recursive)
+  /// move construct an expression, leaving a as a None Expression
+  Expression(Expression && a) noexcept;
+
+  /// copy assign an expression, sharing its tail and properties
   Expression & operator=(const Expression & a);
 
+  /// move assign an expression, leaving a as a None Expression
+  Expression & operator=(Expression && a) noexcept;
+
+  /// destroy an expression, without recursion however deep the tree
+  ~Expression(){ if(m_tail && m_tail.use_count() == 1) releaseTail(m_tail); }
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -55,16 +186,23 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
-  /// append Expression to tail of the expression
+  /// append Expression to tail of the expression. This is O(1) amortized
+  /// when the tail is not shared with another Expression
   void append(const Expression & e);
 
+  /// append Expression to tail of the expression, moving it
+  void append(Expression && e);
+
   /// return a pointer to the last expression in the tail, or nullptr
+  /// (unshares the tail, since the result may be mutated)
   Expression * tail();
 
-  /// return a const-iterator to the beginning of tail
+  /// return a const-iterator to the beginning of an unpacked tail; asserts
+  /// that the list is not packed
   ConstIteratorType tailConstBegin() const noexcept;
 
-  /// return a const-iterator to the tail end
+  /// return a const-iterator to the end of an unpacked tail; asserts that
+  /// the list is not packed
   ConstIteratorType tailConstEnd() const noexcept;
 
   /// convienience member to determine if head atom is a number
@@ -88,23 +226,53 @@ public:
   /// convienience member to determine if head atom is a none kind
   bool isHeadList() const noexcept;
 
-  /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  /// Evaluate expression using a post-order traversal (iterative, with
+  /// proper tail calls)
+  Expression eval(Environment & env) const;
+
+  /// Resolve the references to lambda parameters in this tree to their
+  /// slots (see Atom::slot), so evaluation finds them without searching.
+  /// Run once on a parsed program, before evaluating it
+  void resolve();
 
   /// equality comparison for two expressions (recursive)
   bool operator==(const Expression & exp) const noexcept;
 
-  std::vector<Expression> getTail() const noexcept;
+  /// return a const-reference to the tail, valid while this is unmodified.
+  /// A packed list has no such tail: check packed first, since calling this
+  /// on one is an assertion failure
+  const std::vector<Expression> & getTail() const noexcept;
+
+  /// return element i of the tail, packed or not, throwing
+  /// std::out_of_range as vector::at does
+  Expression tailAt(std::size_t i) const;
+
+  /// return a copy of the elements of the tail, packed or not
+  std::vector<Expression> unpackTail() const;
 
+  /// return the number of expressions in the tail
   size_t tailLength() const noexcept;
 
-  Expression getProperty(std::string key);
+  /// return the packed storage of a packed list, or nullptr
+  const PackedTail * packed() const noexcept;
 
-  void setProperty(std::string key, Expression val);
+  /// return the property stored under the interned key, or the None Expression
+  Expression getProperty(SymbolId key) const;
 
-  void setPropertyList(std::map<std::string,Expression> map);
+  /// return the property stored under key, or the None Expression
+  Expression getProperty(const std::string & key) const;
 
-  std::map<std::string, Expression> getPropertyList();
+  /// store val as the property under the interned key
+  void setProperty(SymbolId key, const Expression & val);
+
+  /// store val as the property key
+  void setProperty(const std::string & key, const Expression & val);
+
+  /// replace the whole property list
+  void setPropertyList(const PropertyList & list) noexcept;
+
+  /// return a const-reference to the property list
+  const PropertyList & getPropertyList() const noexcept;
   
 private:
 
@@ -112,19 +280,29 @@ private:
   Atom m_head;
 
   // the tail list is expressed as a vector for access efficiency
-  // and cache coherence, at the cost of wasted memory.
-  std::vector<Expression> m_tail;
+  // and cache coherence, at the cost of wasted memory. It is shared
+  // between copies and null when empty, and always null for a packed list.
+  std::shared_ptr<std::vector<Expression>> m_tail;
 
-  std::map<std::string, Expression> property_list;
+  // packed elements of a list of Numbers or Complex values, or null
+  std::shared_ptr<PackedTail> m_packed;
+
+  // the property list, shared between copies and null when empty
+  PropertyList property_list;
 
   // convenience typedef
-  typedef std::vector<Expression>::iterator IteratorType;
+  typedef std::vector<Expression>::const_iterator IteratorType;
+
+  // return the tail for modification, copying it first if shared
+  std::vector<Expression> & mutableTail();
+
+  // drop a reference to a tail, destroying deep trees iteratively
+  static void releaseTail(std::shared_ptr<std::vector<Expression>> & tail);
   
   // internal helper methods
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_lambda();
+  Expression handle_lookup(const Atom & head, const Environment & env) const;
+  void check_define(const Environment & env) const;
+  Expression handle_lambda() const;
 };
 
 /// Render expression to output stream
@@ -1,6 +1,11 @@
 #include "catch.hpp"
 
 #include "expression.hpp"
+#include "parse.hpp"
+
+#include <functional>
+#include <sstream>
+#include <stdexcept>
 
 TEST_CASE( "Test default expression", "[expression]" ) {
 
@@ -27,3 +32,133 @@ TEST_CASE( "Test symbol expression", "[expression]" ) {
   REQUIRE(exp.isHeadSymbol());
 }
 
+
+TEST_CASE( "Test copies share the tail until written", "[expression]" ) {
+
+  std::vector<Expression> items = {Expression(1.0), Expression(2.0)};
+  Expression list(items);
+
+  Expression copy = list;
+  REQUIRE(&copy.getTail() == &list.getTail());
+  REQUIRE(copy == list);
+
+  copy.append(Expression(3.0));
+  REQUIRE(&copy.getTail() != &list.getTail());
+  REQUIRE(list.tailLength() == 2);
+  REQUIRE(copy.tailLength() == 3);
+
+  Expression tagged = list;
+  tagged.setProperty("\"note\"", Expression(Atom("\"hi\"")));
+  REQUIRE(tagged.getProperty("\"note\"") == Expression(Atom("\"hi\"")));
+  REQUIRE(list.getProperty("\"note\"") == Expression());
+  REQUIRE(list.getPropertyList().empty());
+}
+
+
+TEST_CASE( "Test property lists", "[expression]" ) {
+
+  // an expression without properties pays one null pointer
+  REQUIRE(sizeof(PropertyList) == sizeof(void *));
+  Expression plain(1.0);
+  REQUIRE(plain.getPropertyList().empty());
+  REQUIRE(plain.getPropertyList().begin() == plain.getPropertyList().end());
+
+  SymbolId size = intern("\"size\"");
+  SymbolId name = intern("\"object-name\"");
+
+  Expression point(2.0);
+  point.setProperty(size, Expression(0.5));
+  point.setProperty("\"object-name\"", Expression(Atom("\"point\"")));
+  point.setProperty(size, Expression(1.0));
+  REQUIRE(point.getPropertyList().size() == 2);
+  REQUIRE(point.getProperty(size) == Expression(1.0));
+  REQUIRE(point.getProperty(name) == Expression(Atom("\"point\"")));
+  REQUIRE(point.getProperty(intern("\"thickness\"")) == Expression());
+
+  // entries are kept in key order
+  const PropertyList & list = point.getPropertyList();
+  REQUIRE(std::less<SymbolId>()(list.begin()->first, (list.begin() + 1)->first));
+
+  PropertyList copy = point.getPropertyList();
+  plain.setPropertyList(copy);
+  plain.setProperty(size, Expression(3.0));
+  REQUIRE(point.getProperty(size) == Expression(1.0));
+  REQUIRE(plain.getProperty(size) == Expression(3.0));
+  REQUIRE(plain.getProperty(name) == Expression(Atom("\"point\"")));
+}
+
+TEST_CASE( "Test moving an expression takes its tail", "[expression]" ) {
+
+  std::vector<Expression> items = {Expression(Atom("\"a\"")), Expression(Atom("\"b\""))};
+  Expression list(std::move(items));
+  const std::vector<Expression> * tail = &list.getTail();
+
+  Expression moved(std::move(list));
+  REQUIRE(&moved.getTail() == tail);
+  REQUIRE(list.isHeadNone());
+  REQUIRE(list.tailLength() == 0);
+
+  // a uniquely owned tail is appended to in place
+  moved.append(Expression(Atom("\"c\"")));
+  REQUIRE(moved.tailLength() == 3);
+
+  Expression assigned;
+  assigned = std::move(moved);
+  REQUIRE(assigned.tailLength() == 3);
+  REQUIRE(moved.isHeadNone());
+}
+
+TEST_CASE( "Test packed numeric lists", "[expression]" ) {
+
+  std::vector<Expression> items = {Expression(1.0), Expression(2.0), Expression(3.0)};
+  Expression packed = Expression::makeList(items);
+  Expression boxed(items);
+
+  REQUIRE(packed.packed() != nullptr);
+  REQUIRE(packed.packed()->numbers == std::vector<double>({1.0, 2.0, 3.0}));
+  REQUIRE(boxed.packed() == nullptr);
+  REQUIRE(packed.isHeadList());
+  REQUIRE(packed.tailLength() == 3);
+  REQUIRE(packed == boxed);
+
+  // elements are read from the packed values, which stay the only storage
+  REQUIRE(packed.tailAt(1) == Expression(2.0));
+  REQUIRE_THROWS_AS(packed.tailAt(3), std::out_of_range);
+  REQUIRE(packed.unpackTail() == items);
+  REQUIRE(packed.packed() != nullptr);
+
+  // appending a number keeps it packed, anything else unpacks
+  Expression more = packed;
+  more.append(Expression(4.0));
+  REQUIRE(more.packed() != nullptr);
+  REQUIRE(more.tailLength() == 4);
+  REQUIRE(packed.tailLength() == 3);
+
+  more.append(Expression(Atom("\"text\"")));
+  REQUIRE(more.packed() == nullptr);
+  REQUIRE(more.tailLength() == 5);
+
+  std::vector<Expression> mixed = {Expression(1.0), Expression(std::complex<double>(0, 1))};
+  REQUIRE(Expression::makeList(mixed).packed() == nullptr);
+}
+
+TEST_CASE( "Test resolving lambda parameters", "[expression]" ) {
+
+  std::istringstream program("(define f (lambda (x y x) (+ x y z (lambda (w) (+ w x)))))");
+  Expression exp = parse(tokenize(program));
+  exp.resolve();
+
+  const Expression & body = exp.getTail()[1].getTail()[1];
+  REQUIRE(body.head().slot() == Atom::NO_SLOT);
+  REQUIRE(body.getTail()[0].head().slot() == 0);
+  REQUIRE(body.getTail()[1].head().slot() == 1);
+  REQUIRE(body.getTail()[2].head().slot() == Atom::NO_SLOT);
+
+  // references in a nested lambda only resolve to its own parameters
+  const Expression & inner = body.getTail()[3].getTail()[1];
+  REQUIRE(inner.getTail()[0].head().slot() == 0);
+  REQUIRE(inner.getTail()[1].head().slot() == Atom::NO_SLOT);
+
+  // symbols outside any lambda have no slot
+  REQUIRE(exp.getTail()[0].head().slot() == Atom::NO_SLOT);
+}
@@ -1,6 +1,7 @@
 #include "interpreter.hpp"
 
 // system includes
+#include <new>
 #include <stdexcept>
 
 // module includes
@@ -10,17 +11,76 @@
 #include "environment.hpp"
 #include "semantic_error.hpp"
 
-bool Interpreter::parseStream(std::istream & expression) noexcept{
+Interpreter::Interpreter(std::shared_ptr<const Environment> snapshot): env(snapshot) {}
 
-  TokenSequenceType tokens = tokenize(expression);
+std::shared_ptr<const Environment> Interpreter::snapshot() const{
+  return env.snapshot();
+}
 
-  ast = parse(tokens);
+// parses exactly one form from parser into ast
+static bool parseOne(StreamParser & parser, Expression & ast) noexcept{
+  try{
+    Expression form, rest;
+    if(parser.next(form) != StreamParser::FORM || parser.next(rest) != StreamParser::END){
+      ast = Expression();
+      return false;
+    }
+    ast = form;
+    ast.resolve();
+  }
+  catch(const std::bad_alloc &){
+    ast = Expression();
+    return false;
+  }
 
   return (ast != Expression());
+}
+
+bool Interpreter::parseStream(std::istream & expression) noexcept{
+
+  StreamParser parser(expression);
+
+  return parseOne(parser, ast);
 };
+
+bool Interpreter::parseBuffer(const char * buffer, std::size_t size) noexcept{
+
+  StreamParser parser(buffer, size);
+
+  return parseOne(parser, ast);
+}
+
+// reads the next form from source, which is a StreamParser or CachedProgram, into ast
+template <typename Source>
+static StreamParser::Status nextForm(Source & source, Expression & ast) noexcept{
+  try{
+    StreamParser::Status status = source.next(ast);
+    if(status == StreamParser::FORM) ast.resolve();
+    else ast = Expression();
+    return status;
+  }
+  catch(const std::bad_alloc &){
+    ast = Expression();
+    return StreamParser::ERROR;
+  }
+}
+
+StreamParser::Status Interpreter::parseNext(StreamParser & parser) noexcept{
+
+  return nextForm(parser, ast);
+}
+
+StreamParser::Status Interpreter::parseNext(CachedProgram & program) noexcept{
+
+  return nextForm(program, ast);
+}
 				     
 
 Expression Interpreter::evaluate(){
 
   return ast.eval(env);
 }
+
+void Interpreter::setInterrupt(const Interrupt * flag) noexcept{
+  env.set_interrupt(flag);
+}
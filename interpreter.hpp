@@ -8,12 +8,16 @@ It maintains an environment during evaluation.
 #define INTERPRETER_HPP
 
 // system includes
+#include <cstddef>
 #include <istream>
+#include <memory>
 #include <string>
 
 // module includes
 #include "environment.hpp"
+#include "ast_cache.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
 
 /*! \class Interpreter
 \brief Class to parse and evaluate an expression (program)
@@ -25,18 +29,59 @@ The eval method updates Environment and returns last result.
 class Interpreter {
 public:
 
+  /// Construct with the default environment
+  Interpreter() = default;
+
+  /*! Construct with an environment forked from snapshot, in constant time
+    \param snapshot the environment to start from, see Environment::snapshot
+   */
+  explicit Interpreter(std::shared_ptr<const Environment> snapshot);
+
+  /*! Capture the current environment, e.g. after a startup file, so other
+    interpreters can start from it
+    \return the snapshot
+   */
+  std::shared_ptr<const Environment> snapshot() const;
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing 
    */
   bool parseStream(std::istream &expression) noexcept;
 
+  /*! Parse into an internal Expression from a buffer, such as a MappedFile,
+    tokenizing it in place without copying
+    \param buffer the raw text representing the candidate expression
+    \param size the number of characters in buffer
+    \return true on successful parsing
+   */
+  bool parseBuffer(const char * buffer, std::size_t size) noexcept;
+
+  /*! Parse the next top-level form of a longer program into the internal
+    Expression, so it can be evaluated before the rest is read
+    \param parser the StreamParser reading the program
+    \return FORM on success, END when no forms remain, ERROR if the program is invalid
+   */
+  StreamParser::Status parseNext(StreamParser & parser) noexcept;
+
+  /*! Read the next top-level form of a program file into the internal
+    Expression, from its binary cache when that is current (see CachedProgram)
+    \param program the CachedProgram reading the file
+    \return FORM on success, END when no forms remain, ERROR if the program is invalid
+   */
+  StreamParser::Status parseNext(CachedProgram & program) noexcept;
+
   /*! Evaluate the Expression by walking the tree, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
   Expression evaluate();
 
+  /*! Poll the given Interrupt while evaluating, see Interrupt.
+    \param flag the interrupt to poll, or nullptr for none
+   */
+  void setInterrupt(const Interrupt * flag) noexcept;
+
 private:
 
   // the environment
@@ -5,9 +5,12 @@
 #include <fstream>
 #include <iostream>
 #include <complex>
+#include <thread>
+#include <chrono>
 
 #include "semantic_error.hpp"
 #include "interpreter.hpp"
+#include "interrupt.hpp"
 #include "expression.hpp"
 
 Expression run(const std::string & program){
@@ -993,6 +996,18 @@ TEST_CASE("Tesst for append procedure involving lists", "[interpreter]") {
 		expected.push_back(Expression(4));
 		REQUIRE(result == Expression(expected));
 	}
+
+	{
+		// the result never keeps the properties of the list, however the list is stored
+		std::vector<std::string> programs = {
+			"(get-property \"k\" (append (set-property \"k\" 1 (list 1 2)) 3))", //a packed list of numbers
+			"(get-property \"k\" (append (set-property \"k\" 1 (list 1 \"a\")) 3))" }; //an unpacked list
+
+		for (auto s : programs) {
+			INFO(s);
+			REQUIRE(run(s) == Expression());
+		}
+	}
 }
 
 TEST_CASE("Test for join procedure involving lists", "[interpreter]") {
@@ -1135,6 +1150,27 @@ TEST_CASE("Testa for lambda function generation", "[interpreter]") {
 
 }
 
+TEST_CASE("Testing lambda parameters resolved to slots", "[interpreter]") {
+
+  {
+    INFO("free symbols in a body are still scoped dynamically");
+    std::string program = "(begin (define g (lambda (a) (+ a b))) (define h (lambda (b) (g 1))) (h 10))";
+    REQUIRE(run(program) == Expression(11.));
+  }
+
+  {
+    INFO("a repeated parameter binds its last argument");
+    std::string program = "(begin (define f (lambda (x x) x)) (f 1 2))";
+    REQUIRE(run(program) == Expression(2.));
+  }
+
+  {
+    INFO("a parameter shadows a built-in and can be called");
+    std::string program = "(begin (define f (lambda (+ x) (+ x))) (f (lambda (y) (* y 2)) 4))";
+    REQUIRE(run(program) == Expression(8.));
+  }
+}
+
 TEST_CASE("Tests for apply function", "[interpreter]") {
 
 	//test that all semantic errors get thrown when needed
@@ -1310,6 +1346,52 @@ TEST_CASE("Tests for map function", "[interpreter]") {
 
 }
 
+TEST_CASE("Tests for pmap function", "[interpreter]") {
+
+	//pmap checks its arguments like map, and errors in any chunk are reported
+	{
+		std::vector<std::string> programs = { "(pmap 2 1)",
+			"(pmap 1)",
+			"(pmap 1 (list 1 2))",
+			"(pmap (lambda (x y) (+ x y)) (list 1 2))",
+			"(pmap / (list (list 1 2) (list 1 2 3)))",
+			"(pmap (lambda (x) (first x)) (range 0 100 1))" };
+
+		for (auto s : programs) {
+			INFO(s);
+			Interpreter interp;
+			std::istringstream iss(s);
+			interp.parseStream(iss);
+			REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+		}
+	}
+
+	//results are the same as map's, in order, for procedures and lambdas
+	{
+		std::vector<std::string> programs = {
+			"-",
+			"(lambda (x) (list x (+ (* x x) 1)))",
+			"(lambda (x) (length (pmap sqrt (range 0 (+ x 1) 1))))" };
+
+		for (auto f : programs) {
+			std::string program = "(list (map " + f + " (range 0 100 1)) (pmap " + f + " (range 0 100 1)))";
+			INFO(program);
+			Expression result = run(program);
+			bool same = (result.getTail()[0] == result.getTail()[1]);
+			REQUIRE(same);
+			REQUIRE(result.getTail()[1].tailLength() == 101);
+		}
+	}
+
+	{
+		std::string program = "(pmap - (list 1 2 3))";
+		INFO(program);
+		Expression result = run(program);
+		std::vector<Expression> expected = { Expression(-1), Expression(-2), Expression(-3) };
+		REQUIRE(result == Expression(expected));
+	}
+}
+
 TEST_CASE("Testing creation of strings", "[interpreter]") {
 
 	{
@@ -1379,6 +1461,23 @@ TEST_CASE("Testing set-property and get-property methods", "[interpreter]") {
 	REQUIRE(result == Expression(Atom("\"a complex number\"")));
 	}
 
+	{
+	// the arguments are owned by the procedure, so results can be built up in place
+	// without changing the values bound to symbols
+	std::string program = R"((begin
+(define a (list 1 2))
+(define b (append (append (append a 3) "x") 4))
+(define c (set-property "note" "c" (set-property "note" "b" (append b 5))))
+(list (length a) (length b) (length c) (get-property "note" c) (get-property "note" b))
+))";
+	INFO(program);
+	Expression result = run(program);
+	std::vector<Expression> expected = {Expression(2.0), Expression(5.0), Expression(6.0),
+		Expression(Atom("\"c\"")), Expression()};
+	bool matches = (result == Expression(expected));
+	REQUIRE(matches);
+	}
+
 	
 
 
@@ -1474,7 +1573,255 @@ TEST_CASE("Testing continuous-plot", "[interpreter]") {
 		REQUIRE(result.getTail().size() == 75);
 	}
 
+	{
+		// the samples are evaluated in parallel: they see global definitions, and an
+		// error at any of them is reported
+		std::string program = R"(
+	(begin
+	(define scale 3)
+	(define f (lambda (x) (* scale x)))
+	(continuous-plot f (list -1 1)))
+	)";
+		INFO(program);
+		Expression result = run(program);
+		REQUIRE(result.getTail().size() == 60);
+
+		Interpreter interp;
+		std::istringstream iss("(continuous-plot (lambda (x) (first x)) (list -1 1))");
+		interp.parseStream(iss);
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+
+
+
+
+}
+TEST_CASE("Testing arithmetic broadcasting over lists", "[interpreter]") {
+
+	{
+		std::vector<Expression> expected = { Expression(2.0), Expression(4.0), Expression(6.0) };
+		REQUIRE(run("(* 2 (list 1 2 3))") == Expression(expected));
+		REQUIRE(run("(+ (list 1 2 3) (list 1 2 3))") == Expression(expected));
+		REQUIRE(run("(- (list 3 6 9) (list 1 2 3))") == Expression(expected));
+		REQUIRE(run("(/ (list 4 8 12) 2)") == Expression(expected));
+		REQUIRE(run("(sqrt (list 4 16 36))") == Expression(expected));
+	}
 
+	{
+		std::vector<Expression> expected = { Expression(-1.0), Expression(0.5) };
+		REQUIRE(run("(- (list 1 -0.5))") == Expression(expected));
+		REQUIRE(run("(/ (list -1 2))") == Expression(expected));
+	}
+
+	{
+		// complex values, and the unpacked fallback for mixed lists
+		std::vector<Expression> expected = { Expression(std::complex<double>(1, 1)), Expression(std::complex<double>(2, 1)) };
+		REQUIRE(run("(+ I (list 1 2))") == Expression(expected));
+		REQUIRE(run("(+ (list I I) (list 1 2))") == Expression(expected));
+		REQUIRE(run("(- (list (+ 2 I) (+ 3 I)) 1)") == Expression(expected));
+
+		std::vector<Expression> mixed = { Expression(2.0), Expression(std::complex<double>(0, 2)) };
+		REQUIRE(run("(sqrt (list 4 -4))") == Expression(mixed));
+		REQUIRE(run("(* 2 (list 1 I))") == Expression(mixed));
+	}
+
+	{
+		std::vector<Expression> expected = { Expression(std::sin(1.0)), Expression(std::sin(2.0)) };
+		REQUIRE(run("(sin (list 1 2))") == Expression(expected));
+		std::vector<Expression> squares = { Expression(1.0), Expression(4.0) };
+		REQUIRE(run("(^ (list 1 2) 2)") == Expression(squares));
+		REQUIRE(run("(ln (list 1))") == Expression(std::vector<Expression>{ Expression(0.0) }));
+	}
 
+	std::vector<std::string> programs = { "(+ (list 1 2) (list 1 2 3))",
+		"(+ 1 (list \"a\"))",
+		"(ln (list 1 -1))",
+		"(sin (list I))",
+		"(- (list 1) 1 1)" };
 
-}
\ No newline at end of file
+	for (auto s : programs) {
+		INFO(s);
+		Interpreter interp;
+		std::istringstream iss(s);
+		interp.parseStream(iss);
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("Testing packed lists read by the generic built-ins", "[interpreter]") {
+
+	// r stays packed: each built-in reads its values without a boxed copy
+	std::vector<Expression> doubled = { Expression(0.0), Expression(2.0), Expression(4.0) };
+	REQUIRE(run("(begin (define r (range 0 2 1)) (map (lambda (x) (* 2 x)) r))") == Expression(doubled));
+	REQUIRE(run("(begin (define r (list 3 4)) (apply (lambda (a b) (- b a)) r))") == Expression(1.0));
+	REQUIRE(run("(apply + (list 1 2 3))") == Expression(6.0));
+
+	std::vector<Expression> joined = { Expression(1.0), Expression(2.0), Expression(Atom("\"a\"")) };
+	REQUIRE(run("(join (list 1 2) (list \"a\"))") == Expression(joined));
+
+	Expression packed = run("(list 1 2)");
+	REQUIRE(packed.packed() != nullptr);
+	std::ostringstream out;
+	out << packed;
+	REQUIRE(out.str() == "((1) (2))");
+
+	// calling a symbol bound to a list, packed or not, or to a number is an error
+	std::vector<std::string> programs = { "(begin (define a (list 1 2)) (a 3))",
+		"(begin (define a (list 1 \"s\")) (a 3))", "(begin (define a 5) (a 3))" };
+	for (auto s : programs) {
+		INFO(s);
+		Interpreter interp;
+		std::istringstream iss(s);
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("Testing deep expressions and tail calls", "[interpreter]") {
+
+	{
+		// far deeper than the native stack would allow a recursive evaluator
+		std::string program;
+		for (int i = 0; i < 100000; i++) program += "(+ 1 ";
+		program += "0";
+		for (int i = 0; i < 100000; i++) program += ")";
+		REQUIRE(run(program) == Expression(100000.0));
+	}
+
+	{
+		// a lambda called in tail position still sees its caller's bindings
+		std::string program = R"((begin
+(define g (lambda (y) (+ x y z)))
+(define f (lambda (x) (begin (define z 3) (g 1))))
+(define h (lambda (x) (f (* 2 x))))
+(h 5)
+))";
+		INFO(program);
+		REQUIRE(run(program) == Expression(14.0));
+	}
+
+	{
+		// and the frames it replaced leave nothing behind
+		std::string program = "(begin (define f (lambda (x) (begin (define z x) z))) (f 1) z)";
+		INFO(program);
+		Interpreter interp;
+		std::istringstream iss(program);
+		interp.parseStream(iss);
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("Testing interrupting an evaluation", "[interpreter]") {
+
+	Interrupt interrupt;
+	Interpreter interp;
+	interp.setInterrupt(&interrupt);
+
+	{
+		std::istringstream iss("(begin (define a 1) (define f (lambda (x) (f x))))");
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_NOTHROW(interp.evaluate());
+	}
+
+	{
+		// runs forever in constant space until interrupted from another thread
+		std::istringstream iss("(f a)");
+		REQUIRE(interp.parseStream(iss));
+		interrupt.start();
+		std::thread stopper([&interrupt]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			interrupt.request();
+		});
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+		stopper.join();
+	}
+
+	{
+		// or until the timeout, including inside map
+		interrupt.setTimeout(20);
+		std::istringstream iss("(map (lambda (x) (f x)) (list 1 2))");
+		REQUIRE(interp.parseStream(iss));
+		interrupt.start();
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+		REQUIRE(interrupt.requested());
+		interrupt.setTimeout(0);
+	}
+
+	{
+		// a request made once the next evaluation is armed is kept when it starts
+		std::istringstream iss("(f a)");
+		REQUIRE(interp.parseStream(iss));
+		interrupt.arm();
+		interrupt.request();
+		interrupt.start();
+		REQUIRE(interrupt.requested());
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+
+	{
+		// one aimed at an earlier evaluation is not
+		Interrupt::Generation earlier = interrupt.arm();
+		interrupt.start();
+		interrupt.start();
+		interrupt.request(earlier);
+		REQUIRE(!interrupt.requested());
+	}
+
+	{
+		// the environment survives, and the earlier request is dropped
+		std::istringstream iss("(+ a 1)");
+		REQUIRE(interp.parseStream(iss));
+		interrupt.request();
+		interrupt.start();
+		REQUIRE(interp.evaluate() == Expression(2.0));
+	}
+}
+
+TEST_CASE( "Test evaluating a program form by form", "[interpreter]" ) {
+
+  std::string program = "(define a 2) (define b (* a 3)) (+ a b)";
+  std::istringstream iss(program);
+
+  Interpreter interp;
+  StreamParser parser(iss);
+
+  Expression result;
+  int forms = 0;
+  while(interp.parseNext(parser) == StreamParser::FORM){
+    REQUIRE_NOTHROW(result = interp.evaluate());
+    ++forms;
+  }
+  REQUIRE(forms == 3);
+  REQUIRE(result == Expression(8.));
+
+  std::istringstream bad("(define c 1) (+ c");
+  StreamParser badParser(bad);
+  REQUIRE(interp.parseNext(badParser) == StreamParser::FORM);
+  REQUIRE(interp.parseNext(badParser) == StreamParser::ERROR);
+}
+
+TEST_CASE( "Test interpreters forked from a snapshot", "[interpreter]" ) {
+
+  Interpreter base;
+  std::istringstream startup("(define sq (lambda (x) (* x x)))");
+  REQUIRE(base.parseStream(startup));
+  REQUIRE_NOTHROW(base.evaluate());
+
+  std::shared_ptr<const Environment> snapshot = base.snapshot();
+
+  Interpreter first(snapshot);
+  Interpreter second(snapshot);
+
+  std::istringstream define("(begin (define a (sq 3)) a)");
+  REQUIRE(first.parseStream(define));
+  REQUIRE(first.evaluate() == Expression(9.));
+
+  // the second interpreter has the startup definitions but not the first's
+  std::istringstream use("(sq 4)");
+  REQUIRE(second.parseStream(use));
+  REQUIRE(second.evaluate() == Expression(16.));
+
+  std::istringstream missing("(a)");
+  REQUIRE(second.parseStream(missing));
+  REQUIRE_THROWS_AS(second.evaluate(), SemanticError);
+}
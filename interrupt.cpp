@@ -0,0 +1,70 @@
+#include "interrupt.hpp"
+
+#include <chrono>
+
+#include "semantic_error.hpp"
+
+// steady_clock now, in nanoseconds
+static std::int64_t now(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+thread_local unsigned Interrupt::polls = 0;
+
+Interrupt::Interrupt() noexcept: current(1), cancelled(0), started(1), timeout_ms(0), deadline(0) {}
+
+void Interrupt::request() noexcept{
+  request(current.load(std::memory_order_relaxed));
+}
+
+void Interrupt::request(Generation generation) noexcept{
+  // requests only move forward, so one for a finished evaluation cannot
+  // undo one for the current
+  Generation latest = cancelled.load(std::memory_order_relaxed);
+  while((latest < generation) &&
+        !cancelled.compare_exchange_weak(latest, generation, std::memory_order_relaxed)){}
+}
+
+void Interrupt::setTimeout(long milliseconds) noexcept{
+  timeout_ms.store(milliseconds > 0 ? milliseconds : 0, std::memory_order_relaxed);
+}
+
+long Interrupt::timeout() const noexcept{
+  return timeout_ms.load(std::memory_order_relaxed);
+}
+
+Interrupt::Generation Interrupt::arm() noexcept{
+  return current.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void Interrupt::start() noexcept{
+  long limit = timeout();
+
+  Generation generation = current.load(std::memory_order_relaxed);
+  if(generation == started.load(std::memory_order_relaxed)){
+    generation = arm();
+  }
+  started.store(generation, std::memory_order_relaxed);
+
+  polls = 0;
+  deadline.store(limit > 0 ? now() + limit * 1000000LL : 0, std::memory_order_relaxed);
+}
+
+bool Interrupt::requested() const noexcept{
+  if(cancelled.load(std::memory_order_relaxed) == current.load(std::memory_order_relaxed)) return true;
+
+  std::int64_t limit = deadline.load(std::memory_order_relaxed);
+  return (limit != 0) && (now() >= limit);
+}
+
+void Interrupt::interrupted() const{
+  throw SemanticError("Error: interpreter kernel interrupted");
+}
+
+void Interrupt::check_deadline() const{
+  std::int64_t limit = deadline.load(std::memory_order_relaxed);
+  if((limit != 0) && (now() >= limit)){
+    throw SemanticError("Error: evaluation timed out");
+  }
+}
@@ -0,0 +1,94 @@
+/*! \file interrupt.hpp
+Defines the cancellation token used to stop an evaluation in progress.
+ */
+#ifndef INTERRUPT_HPP
+#define INTERRUPT_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/*! \class Interrupt
+\brief A flag another thread sets to stop the running evaluation.
+
+The evaluator polls the flag at safe points (each evaluation step, each
+lambda call, each element of map and each plot sample) through
+Environment::check_interrupt, which throws a SemanticError once the flag is
+set. The evaluation then unwinds like any other error, leaving the
+environment as it was after the last completed define.
+
+Each evaluation has a generation, and a request stops only the generation it
+targets, so a request left over from an earlier evaluation never stops a
+later one. A dispatcher that hands out work can arm the next generation
+before the evaluation starts; a request made in between then targets that
+evaluation and is kept when it starts.
+
+An optional wall-clock timeout sets the flag automatically when an
+evaluation runs too long. The clock is only read every few hundred polls,
+counted per thread, so polling stays a couple of relaxed atomic loads.
+ */
+class Interrupt {
+public:
+
+  /// identifies one evaluation
+  typedef std::uint64_t Generation;
+
+  /// Construct with no request pending and no timeout
+  Interrupt() noexcept;
+
+  /// Ask the current evaluation, running or armed, to stop. Safe to call
+  /// from any thread and from a signal handler.
+  void request() noexcept;
+
+  /// Ask the evaluation of generation to stop, doing nothing once a later
+  /// generation has been armed. Safe to call from any thread.
+  void request(Generation generation) noexcept;
+
+  /*! Set the timeout applied to each evaluation.
+    \param milliseconds the limit, or 0 for none
+   */
+  void setTimeout(long milliseconds) noexcept;
+
+  /// return the timeout in milliseconds, 0 if there is none
+  long timeout() const noexcept;
+
+  /// Make a new generation current for the next evaluation, dropping any
+  /// request for an earlier one. \return the new generation
+  Generation arm() noexcept;
+
+  /// Prepare for a new evaluation and start the timeout clock. The evaluation
+  /// takes the generation armed since the last start, keeping any request
+  /// made for it, or else arms a new one.
+  void start() noexcept;
+
+  /// return true if the running evaluation should stop
+  bool requested() const noexcept;
+
+  /// throw a SemanticError if the running evaluation should stop
+  void check() const {
+    if(cancelled.load(std::memory_order_relaxed) == current.load(std::memory_order_relaxed)) interrupted();
+    if((deadline.load(std::memory_order_relaxed) != 0) && ((++polls & 255) == 0)){
+      check_deadline();
+    }
+  }
+
+private:
+
+  // the generation of the current evaluation, the latest one requested to
+  // stop and the last one started; the current one stops once it is cancelled
+  std::atomic<Generation> current;
+  std::atomic<Generation> cancelled;
+  std::atomic<Generation> started;
+
+  std::atomic<long> timeout_ms;
+
+  // steady_clock time in nanoseconds when the evaluation times out, or 0
+  std::atomic<std::int64_t> deadline;
+
+  // polls since the clock was last read, on the polling thread
+  static thread_local unsigned polls;
+
+  [[noreturn]] void interrupted() const;
+  void check_deadline() const;
+};
+
+#endif
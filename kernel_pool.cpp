@@ -0,0 +1,286 @@
+#include "kernel_pool.hpp"
+
+#include <sstream>
+
+#include "semantic_error.hpp"
+
+KernelPool::Result evaluate_input(Interpreter & interp, const std::string & input, Interrupt * interrupt){
+
+  KernelPool::Result result;
+  std::istringstream expression(input);
+
+  if(!interp.parseStream(expression)){
+    result.first = "Error: Invalid Expression. Could not parse.";
+    return result;
+  }
+
+  try{
+    if(interrupt) interrupt->start();
+    result.second = interp.evaluate();
+  }
+  catch(const SemanticError & ex){
+    // including an interrupt; the environment keeps everything defined before the error
+    result.first = ex.what();
+  }
+  return result;
+}
+
+KernelPool::KernelPool(std::shared_ptr<const Environment> snapshot, std::size_t count, std::size_t queue_depth):
+  snapshot(snapshot), depth(queue_depth), completed(0), total_latency_ns(0), max_latency_ns(0){
+
+  if(count == 0) count = 1;
+
+  for(std::size_t i = 0; i < count; ++i){
+    kernels.emplace_back(new Kernel(queue_depth));
+  }
+  for(auto & kernel : kernels){
+    kernel->thread = std::thread(&KernelPool::work, this, std::ref(*kernel));
+  }
+}
+
+KernelPool::~KernelPool(){
+  for(auto & kernel : kernels){
+    Job job;
+    job.stop = true;
+    kernel->jobs.push(std::move(job));
+  }
+  for(auto & kernel : kernels){
+    kernel->thread.join();
+  }
+}
+
+void KernelPool::submit(const std::string & session, std::string program, Callback done){
+
+  Job job;
+  job.program = std::move(program);
+  job.done = std::move(done);
+  job.submitted = Clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    std::shared_ptr<Session> & route = routes[session];
+    if(!route){
+      // a new session goes to the kernel serving the fewest
+      std::size_t best = 0;
+      for(std::size_t i = 1; i < kernels.size(); ++i){
+        if(kernels[i]->sessions < kernels[best]->sessions) best = i;
+      }
+      route = std::make_shared<Session>();
+      route->kernel = best;
+      kernels[best]->sessions++;
+    }
+    job.session = route;
+
+    // close marks a session closed only while it holds routes_mutex, so the
+    // route found here stays open and the job is counted before close sees it
+    std::lock_guard<std::mutex> session_lock(route->mutex);
+    route->pending++;
+    job.number = ++route->submitted;
+  }
+
+  enqueue(*kernels[job.session->kernel], std::move(job));
+}
+
+std::future<KernelPool::Result> KernelPool::submit(const std::string & session, std::string program){
+  std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+  submit(session, std::move(program), [promise](Result && result){ promise->set_value(std::move(result)); });
+  return promise->get_future();
+}
+
+void KernelPool::submit_any(std::string program, Callback done){
+
+  Job job;
+  job.program = std::move(program);
+  job.done = std::move(done);
+  job.submitted = Clock::now();
+  enqueue(least_loaded(), std::move(job));
+}
+
+void KernelPool::submit_any(Program program, Callback done){
+
+  Job job;
+  job.run = std::move(program);
+  job.done = std::move(done);
+  job.submitted = Clock::now();
+  enqueue(least_loaded(), std::move(job));
+}
+
+std::future<KernelPool::Result> KernelPool::submit_any(std::string program){
+  std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+  submit_any(std::move(program), [promise](Result && result){ promise->set_value(std::move(result)); });
+  return promise->get_future();
+}
+
+std::size_t KernelPool::close(const std::string & session){
+
+  std::shared_ptr<Session> route;
+  std::size_t discarded;
+  {
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    auto it = routes.find(session);
+    if(it == routes.end()) return 0;
+    route = it->second;
+    routes.erase(it);
+    kernels[route->kernel]->sessions--;
+
+    // the kernel drops the environment when it next sees the closed session
+    std::lock_guard<std::mutex> session_lock(route->mutex);
+    route->closed = true;
+    discarded = route->pending;
+    route->pending = 0;
+  }
+
+  // a closing job, so the environment is dropped even if nothing else is queued
+  Job job;
+  job.session = route;
+  job.submitted = Clock::now();
+  enqueue(*kernels[route->kernel], std::move(job));
+
+  return discarded;
+}
+
+void KernelPool::interrupt(const std::string & session){
+
+  std::shared_ptr<Session> route;
+  {
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    auto it = routes.find(session);
+    if(it == routes.end()) return;
+    route = it->second;
+  }
+
+  // a queued job sees this when it starts; the kernel publishes the running
+  // job before it looks, so one of the two always catches the job
+  std::uint64_t last;
+  {
+    std::lock_guard<std::mutex> lock(route->mutex);
+    route->interrupted = route->submitted;
+    last = route->submitted;
+  }
+
+  Kernel & kernel = *kernels[route->kernel];
+  std::lock_guard<std::mutex> lock(kernel.running_mutex);
+  if(kernel.running == route.get() && kernel.number <= last){
+    kernel.interrupt.request(kernel.generation);
+  }
+}
+
+void KernelPool::setTimeout(long milliseconds){
+  for(auto & kernel : kernels){
+    kernel->interrupt.setTimeout(milliseconds);
+  }
+}
+
+KernelPool::Metrics KernelPool::metrics() const{
+
+  Metrics metrics;
+  metrics.kernels = kernels.size();
+  metrics.queue_depth = depth;
+  for(const auto & kernel : kernels){
+    metrics.load.push_back(kernel->load.load());
+  }
+  {
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    metrics.sessions = routes.size();
+  }
+
+  metrics.completed = completed.load();
+  metrics.mean_latency_ms = (metrics.completed > 0) ?
+    total_latency_ns.load() / 1e6 / metrics.completed : 0.0;
+  metrics.max_latency_ms = max_latency_ns.load() / 1e6;
+  return metrics;
+}
+
+KernelPool::Kernel & KernelPool::least_loaded(){
+  std::size_t best = 0;
+  for(std::size_t i = 1; i < kernels.size(); ++i){
+    if(kernels[i]->load.load() < kernels[best]->load.load()) best = i;
+  }
+  return *kernels[best];
+}
+
+void KernelPool::enqueue(Kernel & kernel, Job && job){
+  kernel.load++;
+  kernel.jobs.push(std::move(job));
+}
+
+void KernelPool::work(Kernel & kernel){
+
+  // the environments of the sessions routed here, only touched on this thread
+  std::unordered_map<const Session *, std::unique_ptr<Interpreter>> interpreters;
+
+  while(true){
+    Job job;
+    kernel.jobs.wait_and_pop(job);
+    if(job.stop) break;
+
+    if(!job.session){
+      Interpreter interp(snapshot);
+      interp.setInterrupt(&kernel.interrupt);
+      finish(kernel, job, job.run ? job.run(interp, &kernel.interrupt) :
+             evaluate_input(interp, job.program, &kernel.interrupt));
+      continue;
+    }
+
+    bool closed;
+    {
+      std::lock_guard<std::mutex> lock(job.session->mutex);
+      closed = job.session->closed;
+      if(!closed) job.session->pending--;
+    }
+    if(closed){
+      interpreters.erase(job.session.get());
+      if(job.done){
+        finish(kernel, job, Result("Error: session closed", Expression()));
+      }
+      else{
+        // the job close queued
+        kernel.load--;
+      }
+      continue;
+    }
+
+    std::unique_ptr<Interpreter> & interp = interpreters[job.session.get()];
+    if(!interp){
+      interp.reset(new Interpreter(snapshot));
+      interp->setInterrupt(&kernel.interrupt);
+    }
+
+    // arm the job's generation before publishing it, so an interrupt from
+    // here on stops it even though the evaluation has not started
+    {
+      std::lock_guard<std::mutex> lock(kernel.running_mutex);
+      kernel.running = job.session.get();
+      kernel.number = job.number;
+      kernel.generation = kernel.interrupt.arm();
+    }
+    {
+      std::lock_guard<std::mutex> lock(job.session->mutex);
+      if(job.number <= job.session->interrupted){
+        kernel.interrupt.request(kernel.generation);
+      }
+    }
+    Result result = evaluate_input(*interp, job.program, &kernel.interrupt);
+    {
+      std::lock_guard<std::mutex> lock(kernel.running_mutex);
+      kernel.running = nullptr;
+    }
+
+    finish(kernel, job, std::move(result));
+  }
+}
+
+void KernelPool::finish(Kernel & kernel, Job & job, Result && result){
+
+  std::uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - job.submitted).count();
+
+  total_latency_ns += latency;
+  std::uint64_t longest = max_latency_ns.load();
+  while(latency > longest && !max_latency_ns.compare_exchange_weak(longest, latency)){}
+  completed++;
+
+  // the job no longer counts once its result can be seen
+  kernel.load--;
+  if(job.done) job.done(std::move(result));
+}
@@ -0,0 +1,181 @@
+/*! \file kernel_pool.hpp
+Defines the pool of interpreter kernels that evaluates programs for many
+sessions at once.
+ */
+#ifndef KERNEL_POOL_HPP
+#define KERNEL_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "interrupt.hpp"
+#include "ring_queue.hpp"
+
+/*! \class KernelPool
+\brief A fixed set of kernel threads, each evaluating the jobs on its own
+queue in order.
+
+A session is a sequence of programs that share an environment, such as one
+notebook. Its first job picks the kernel with the fewest sessions and every
+later job goes to the same kernel (sticky routing), so the session's
+Interpreter is only ever used by that kernel, in the order the jobs were
+submitted. A stateless job, like a plotscript -e expression, goes to the
+kernel with the shortest queue and runs in an environment of its own that
+is dropped afterwards. Every environment is forked from one snapshot, so
+starting a session costs constant time.
+ */
+class KernelPool {
+public:
+
+  /// the outcome of a job: an error message, empty on success, and the value
+  typedef std::pair<std::string, Expression> Result;
+
+  /// called on the kernel thread with the result of a job
+  typedef std::function<void(Result &&)> Callback;
+
+  /// a job given as code rather than program text: it is run on the kernel
+  /// with the job's interpreter and the kernel's interrupt
+  typedef std::function<Result(Interpreter &, Interrupt *)> Program;
+
+  /*! \struct Metrics
+  \brief A snapshot of the pool's load and of the latency of finished jobs,
+  measured from submit to result.
+   */
+  struct Metrics {
+    std::size_t kernels;             ///< number of kernels
+    std::size_t queue_depth;         ///< jobs each kernel's queue holds before submit waits
+    std::vector<std::size_t> load;   ///< jobs waiting or running, for each kernel
+    std::size_t sessions;            ///< open sessions
+    std::uint64_t completed;         ///< jobs finished
+    double mean_latency_ms;          ///< mean latency of the finished jobs
+    double max_latency_ms;           ///< longest latency of a finished job
+  };
+
+  /*! Start the kernels.
+    \param snapshot the environment every session and job starts from
+    \param kernels the number of kernels, at least one
+    \param queue_depth the capacity of each kernel's queue
+   */
+  KernelPool(std::shared_ptr<const Environment> snapshot, std::size_t kernels, std::size_t queue_depth = 1024);
+
+  /// finish every job already submitted, then stop the kernels
+  ~KernelPool();
+
+  KernelPool(const KernelPool &) = delete;
+  KernelPool & operator=(const KernelPool &) = delete;
+
+  /// evaluate program in session's environment, calling done with the result
+  void submit(const std::string & session, std::string program, Callback done);
+
+  /// evaluate program in session's environment
+  std::future<Result> submit(const std::string & session, std::string program);
+
+  /// evaluate program in a fresh environment on the least loaded kernel,
+  /// calling done with the result
+  void submit_any(std::string program, Callback done);
+
+  /// evaluate program in a fresh environment on the least loaded kernel
+  std::future<Result> submit_any(std::string program);
+
+  /// run program with an interpreter in a fresh environment on the least
+  /// loaded kernel, calling done with its result
+  void submit_any(Program program, Callback done);
+
+  /*! Close a session, dropping its environment. Its jobs that have not
+    started fail with an error result instead of running, and a later job
+    for the same id starts a new session.
+    \return the number of jobs discarded
+   */
+  std::size_t close(const std::string & session);
+
+  /// stop the jobs of session submitted so far with an error result: the
+  /// one running, if any, and those still queued before they start
+  void interrupt(const std::string & session);
+
+  /// limit every job to the given time, 0 for no limit (see Interrupt)
+  void setTimeout(long milliseconds);
+
+  /// return the current load and latency figures
+  Metrics metrics() const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  // what the dispatcher knows about a session, shared with its queued jobs
+  struct Session {
+    std::size_t kernel;
+    std::mutex mutex;
+    std::size_t pending = 0; // jobs submitted but not yet started
+    std::uint64_t submitted = 0; // jobs ever submitted, numbering them
+    std::uint64_t interrupted = 0; // jobs up to this number are interrupted
+    bool closed = false; // only set while the pool's routes_mutex is held
+  };
+
+  struct Job {
+    std::shared_ptr<Session> session; // null for a stateless job
+    std::string program;
+    Program run; // used instead of program when set
+    Callback done;
+    std::uint64_t number = 0; // within its session
+    Clock::time_point submitted;
+    bool stop = false;
+  };
+
+  struct Kernel {
+    explicit Kernel(std::size_t queue_depth): jobs(queue_depth), load(0), sessions(0), running(nullptr), number(0), generation(0) {}
+
+    RingQueue<Job> jobs;
+    std::thread thread;
+    Interrupt interrupt;
+    std::atomic<std::size_t> load;
+    std::size_t sessions; // guarded by the pool's routes_mutex
+
+    // the session job that is running, its number and the interrupt
+    // generation armed for it, guarded by running_mutex
+    std::mutex running_mutex;
+    const Session * running;
+    std::uint64_t number;
+    Interrupt::Generation generation;
+  };
+
+  std::shared_ptr<const Environment> snapshot;
+  std::size_t depth;
+  std::vector<std::unique_ptr<Kernel>> kernels;
+
+  mutable std::mutex routes_mutex;
+  std::unordered_map<std::string, std::shared_ptr<Session>> routes;
+
+  std::atomic<std::uint64_t> completed;
+  std::atomic<std::uint64_t> total_latency_ns;
+  std::atomic<std::uint64_t> max_latency_ns;
+
+  Kernel & least_loaded();
+  void enqueue(Kernel & kernel, Job && job);
+  void work(Kernel & kernel);
+  void finish(Kernel & kernel, Job & job, Result && result);
+};
+
+/*! Parse and evaluate one input in interp, as a kernel does for each job.
+  \param interp the interpreter, whose environment keeps any definitions
+  \param input the program text
+  \param interrupt polled during the evaluation, or nullptr
+  \return the error message (empty on success) and the value
+ */
+KernelPool::Result evaluate_input(Interpreter & interp, const std::string & input, Interrupt * interrupt);
+
+#endif
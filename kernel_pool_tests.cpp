@@ -0,0 +1,142 @@
+#include "catch.hpp"
+
+#include "kernel_pool.hpp"
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test kernel pool sessions keep their environments", "[kernel_pool]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 2);
+
+  std::vector<std::future<KernelPool::Result>> results;
+  results.push_back(pool.submit("a", "(define x 1)"));
+  results.push_back(pool.submit("b", "(define x 2)"));
+  results.push_back(pool.submit("a", "(+ x 10)"));
+  results.push_back(pool.submit("b", "(+ x 10)"));
+  results.push_back(pool.submit("c", "(+ x 10)"));
+
+  REQUIRE(results[2].get().second == Expression(11.0));
+  REQUIRE(results[3].get().second == Expression(12.0));
+
+  INFO("a session does not see the definitions of another");
+  KernelPool::Result unknown = results[4].get();
+  REQUIRE(!unknown.first.empty());
+
+  INFO("sessions are spread over the kernels");
+  KernelPool::Metrics metrics = pool.metrics();
+  REQUIRE(metrics.kernels == 2);
+  REQUIRE(metrics.sessions == 3);
+  REQUIRE(metrics.completed == 5);
+  REQUIRE(metrics.max_latency_ms >= metrics.mean_latency_ms);
+}
+
+TEST_CASE( "Test kernel pool stateless jobs and errors", "[kernel_pool]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 3, 16);
+  REQUIRE(pool.metrics().queue_depth == 16);
+
+  std::vector<std::future<KernelPool::Result>> results;
+  for(int i = 0; i < 40; ++i){
+    results.push_back(pool.submit_any("(begin (define y " + std::to_string(i) + ") (* y 2))"));
+  }
+  for(int i = 0; i < 40; ++i){
+    KernelPool::Result result = results[i].get();
+    REQUIRE(result.first.empty());
+    REQUIRE(result.second == Expression(2.0 * i));
+  }
+
+  REQUIRE(pool.submit_any("(+ 1").get().first == "Error: Invalid Expression. Could not parse.");
+  REQUIRE(!pool.submit_any("(first 1)").get().first.empty());
+
+  KernelPool::Metrics metrics = pool.metrics();
+  REQUIRE(metrics.sessions == 0);
+  REQUIRE(metrics.completed == 42);
+  for(std::size_t load : metrics.load){
+    REQUIRE(load == 0);
+  }
+}
+
+TEST_CASE( "Test closing and interrupting kernel pool sessions", "[kernel_pool]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 1);
+  std::string forever = "(begin (define f (lambda (n) (f n))) (f 0))";
+
+  INFO("interrupting stops the running job of the session");
+  REQUIRE(pool.submit("a", "(define z 1)").get().first.empty());
+  std::future<KernelPool::Result> running = pool.submit("a", forever);
+  pool.interrupt("a");
+  REQUIRE(running.get().first == "Error: interpreter kernel interrupted");
+  REQUIRE(pool.submit("a", "(+ z 1)").get().second == Expression(2.0));
+
+  INFO("closing drops the environment and the jobs not started");
+  pool.setTimeout(50);
+  pool.submit("a", forever, [](KernelPool::Result &&){});
+  std::future<KernelPool::Result> discarded = pool.submit("a", "(+ z 1)");
+  REQUIRE(pool.close("a") >= 1);
+  REQUIRE(discarded.get().first == "Error: session closed");
+
+  REQUIRE(!pool.submit("a", "(+ z 1)").get().first.empty());
+  REQUIRE(pool.submit("a", "(define z 5)").get().first.empty());
+  REQUIRE(pool.submit("a", "(+ z 1)").get().second == Expression(6.0));
+}
+
+TEST_CASE( "Test submitting to a kernel pool session while it closes", "[kernel_pool]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 2);
+
+  // every job gets a result: it runs in the old session, fails as closed or
+  // runs in a new one, and none is dropped
+  std::vector<std::future<KernelPool::Result>> results;
+  std::thread closer([&pool](){
+    for(int i = 0; i < 200; ++i){
+      pool.close("a");
+    }
+  });
+  for(int i = 0; i < 400; ++i){
+    results.push_back(pool.submit("a", "(+ 1 1)"));
+  }
+  closer.join();
+
+  for(auto & result : results){
+    KernelPool::Result value = result.get();
+    if(value.first.empty()){
+      REQUIRE(value.second == Expression(2.0));
+    }
+    else{
+      REQUIRE(value.first == "Error: session closed");
+    }
+  }
+}
+
+TEST_CASE( "Test stopping a kernel pool session as its job starts", "[kernel_pool]" ) {
+
+  KernelPool pool(Interpreter().snapshot(), 1);
+  std::string forever = "(begin (define f (lambda (n) (f n))) (f 0))";
+
+  // a lost interrupt shows up as the timeout instead of hanging the test
+  pool.setTimeout(10000);
+
+  INFO("stopping as the notebook does, whenever the kernel picks the job up");
+  for(int i = 0; i < 50; ++i){
+    std::future<KernelPool::Result> running = pool.submit("a", forever);
+    pool.interrupt("a");
+    pool.close("a");
+    std::string error = running.get().first;
+    bool stopped = (error == "Error: interpreter kernel interrupted") || (error == "Error: session closed");
+    REQUIRE(stopped);
+  }
+
+  INFO("a job queued behind another session's is stopped before it starts");
+  std::future<KernelPool::Result> other = pool.submit("b", forever);
+  std::future<KernelPool::Result> queued = pool.submit("a", forever);
+  pool.interrupt("a");
+  pool.interrupt("b");
+  REQUIRE(other.get().first == "Error: interpreter kernel interrupted");
+  REQUIRE(queued.get().first == "Error: interpreter kernel interrupted");
+
+  INFO("a later job of the session runs");
+  REQUIRE(pool.submit("a", "(+ 1 1)").get().second == Expression(2.0));
+}
@@ -0,0 +1,215 @@
+#include "kernels.hpp"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/***********************************************************************
+Scalar kernels, used on every platform and for the tail of each vector
+loop.
+**********************************************************************/
+
+static void scalar_vv(KernelOp op, const double * a, const double * b, double * out, std::size_t n){
+  switch(op){
+  case KERNEL_ADD: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] + b[i]; break;
+  case KERNEL_SUB: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] - b[i]; break;
+  case KERNEL_MUL: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] * b[i]; break;
+  case KERNEL_DIV: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] / b[i]; break;
+  }
+}
+
+static void scalar_vs(KernelOp op, const double * a, double b, double * out, std::size_t n){
+  switch(op){
+  case KERNEL_ADD: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] + b; break;
+  case KERNEL_SUB: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] - b; break;
+  case KERNEL_MUL: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] * b; break;
+  case KERNEL_DIV: for(std::size_t i = 0; i < n; ++i) out[i] = a[i] / b; break;
+  }
+}
+
+static void scalar_sv(KernelOp op, double a, const double * b, double * out, std::size_t n){
+  switch(op){
+  case KERNEL_ADD: for(std::size_t i = 0; i < n; ++i) out[i] = a + b[i]; break;
+  case KERNEL_SUB: for(std::size_t i = 0; i < n; ++i) out[i] = a - b[i]; break;
+  case KERNEL_MUL: for(std::size_t i = 0; i < n; ++i) out[i] = a * b[i]; break;
+  case KERNEL_DIV: for(std::size_t i = 0; i < n; ++i) out[i] = a / b[i]; break;
+  }
+}
+
+static void scalar_sqrt(const double * a, double * out, std::size_t n){
+  for(std::size_t i = 0; i < n; ++i) out[i] = std::sqrt(a[i]);
+}
+
+#ifdef X86_KERNELS
+
+/***********************************************************************
+SSE2 kernels, two doubles at a time.
+**********************************************************************/
+
+TARGET("sse2")
+static void sse2_vv(KernelOp op, const double * a, const double * b, double * out, std::size_t n){
+  std::size_t i = 0;
+  switch(op){
+  case KERNEL_ADD: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); break;
+  case KERNEL_SUB: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); break;
+  case KERNEL_MUL: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); break;
+  case KERNEL_DIV: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); break;
+  }
+  scalar_vv(op, a + i, b + i, out + i, n - i);
+}
+
+TARGET("sse2")
+static void sse2_vs(KernelOp op, const double * a, double b, double * out, std::size_t n){
+  std::size_t i = 0;
+  __m128d s = _mm_set1_pd(b);
+  switch(op){
+  case KERNEL_ADD: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), s)); break;
+  case KERNEL_SUB: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i), s)); break;
+  case KERNEL_MUL: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), s)); break;
+  case KERNEL_DIV: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), s)); break;
+  }
+  scalar_vs(op, a + i, b, out + i, n - i);
+}
+
+TARGET("sse2")
+static void sse2_sv(KernelOp op, double a, const double * b, double * out, std::size_t n){
+  std::size_t i = 0;
+  __m128d s = _mm_set1_pd(a);
+  switch(op){
+  case KERNEL_ADD: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(s, _mm_loadu_pd(b + i))); break;
+  case KERNEL_SUB: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_sub_pd(s, _mm_loadu_pd(b + i))); break;
+  case KERNEL_MUL: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(s, _mm_loadu_pd(b + i))); break;
+  case KERNEL_DIV: for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_div_pd(s, _mm_loadu_pd(b + i))); break;
+  }
+  scalar_sv(op, a, b + i, out + i, n - i);
+}
+
+TARGET("sse2")
+static void sse2_sqrt(const double * a, double * out, std::size_t n){
+  std::size_t i = 0;
+  for(; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_loadu_pd(a + i)));
+  scalar_sqrt(a + i, out + i, n - i);
+}
+
+/***********************************************************************
+AVX2 kernels, four doubles at a time.
+**********************************************************************/
+
+TARGET("avx2")
+static void avx2_vv(KernelOp op, const double * a, const double * b, double * out, std::size_t n){
+  std::size_t i = 0;
+  switch(op){
+  case KERNEL_ADD: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); break;
+  case KERNEL_SUB: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); break;
+  case KERNEL_MUL: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); break;
+  case KERNEL_DIV: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); break;
+  }
+  scalar_vv(op, a + i, b + i, out + i, n - i);
+}
+
+TARGET("avx2")
+static void avx2_vs(KernelOp op, const double * a, double b, double * out, std::size_t n){
+  std::size_t i = 0;
+  __m256d s = _mm256_set1_pd(b);
+  switch(op){
+  case KERNEL_ADD: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), s)); break;
+  case KERNEL_SUB: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), s)); break;
+  case KERNEL_MUL: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), s)); break;
+  case KERNEL_DIV: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(a + i), s)); break;
+  }
+  scalar_vs(op, a + i, b, out + i, n - i);
+}
+
+TARGET("avx2")
+static void avx2_sv(KernelOp op, double a, const double * b, double * out, std::size_t n){
+  std::size_t i = 0;
+  __m256d s = _mm256_set1_pd(a);
+  switch(op){
+  case KERNEL_ADD: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(s, _mm256_loadu_pd(b + i))); break;
+  case KERNEL_SUB: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_sub_pd(s, _mm256_loadu_pd(b + i))); break;
+  case KERNEL_MUL: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(s, _mm256_loadu_pd(b + i))); break;
+  case KERNEL_DIV: for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_div_pd(s, _mm256_loadu_pd(b + i))); break;
+  }
+  scalar_sv(op, a, b + i, out + i, n - i);
+}
+
+TARGET("avx2")
+static void avx2_sqrt(const double * a, double * out, std::size_t n){
+  std::size_t i = 0;
+  for(; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(a + i)));
+  scalar_sqrt(a + i, out + i, n - i);
+}
+
+#endif
+
+/***********************************************************************
+Runtime selection
+**********************************************************************/
+
+struct KernelTable {
+  KernelIsa isa;
+  void (*vv)(KernelOp, const double *, const double *, double *, std::size_t);
+  void (*vs)(KernelOp, const double *, double, double *, std::size_t);
+  void (*sv)(KernelOp, double, const double *, double *, std::size_t);
+  void (*sqrt)(const double *, double *, std::size_t);
+};
+
+static const KernelTable SCALAR_TABLE = {KERNEL_SCALAR, scalar_vv, scalar_vs, scalar_sv, scalar_sqrt};
+#ifdef X86_KERNELS
+static const KernelTable SSE2_TABLE = {KERNEL_SSE2, sse2_vv, sse2_vs, sse2_sv, sse2_sqrt};
+static const KernelTable AVX2_TABLE = {KERNEL_AVX2, avx2_vv, avx2_vs, avx2_sv, avx2_sqrt};
+#endif
+
+// the best table no wider than isa that this CPU runs
+static const KernelTable * best_table(KernelIsa isa){
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if((isa >= KERNEL_AVX2) && __builtin_cpu_supports("avx2")) return &AVX2_TABLE;
+  if((isa >= KERNEL_SSE2) && __builtin_cpu_supports("sse2")) return &SSE2_TABLE;
+#else
+  (void)isa;
+#endif
+  return &SCALAR_TABLE;
+}
+
+static std::atomic<const KernelTable *> current_table(nullptr);
+
+static const KernelTable & table(){
+  const KernelTable * t = current_table.load(std::memory_order_acquire);
+  if(t == nullptr){
+    t = best_table(KERNEL_AVX2);
+    current_table.store(t, std::memory_order_release);
+  }
+  return *t;
+}
+
+KernelIsa kernel_isa(){
+  return table().isa;
+}
+
+KernelIsa kernel_select(KernelIsa isa){
+  const KernelTable * t = best_table(isa);
+  current_table.store(t, std::memory_order_release);
+  return t->isa;
+}
+
+void kernel_vv(KernelOp op, const double * a, const double * b, double * out, std::size_t n){
+  table().vv(op, a, b, out, n);
+}
+
+void kernel_vs(KernelOp op, const double * a, double b, double * out, std::size_t n){
+  table().vs(op, a, b, out, n);
+}
+
+void kernel_sv(KernelOp op, double a, const double * b, double * out, std::size_t n){
+  table().sv(op, a, b, out, n);
+}
+
+void kernel_sqrt(const double * a, double * out, std::size_t n){
+  table().sqrt(a, out, n);
+}
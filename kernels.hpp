@@ -0,0 +1,54 @@
+/*! \file kernels.hpp
+Defines the elementwise arithmetic kernels used when built-in procedures
+broadcast over packed lists of Numbers.
+
+Every kernel has a portable scalar version and, on x86, SSE2 and AVX2
+versions. The fastest one the running CPU supports is selected the first
+time a kernel is called.
+ */
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cstddef>
+
+/*! \enum KernelOp
+\brief The binary operations the kernels implement.
+ */
+enum KernelOp {
+  KERNEL_ADD,
+  KERNEL_SUB,
+  KERNEL_MUL,
+  KERNEL_DIV
+};
+
+/*! \enum KernelIsa
+\brief The instruction sets a kernel may be implemented with.
+ */
+enum KernelIsa {
+  KERNEL_SCALAR,
+  KERNEL_SSE2,
+  KERNEL_AVX2
+};
+
+/// the instruction set the kernels currently use
+KernelIsa kernel_isa();
+
+/*! Use the given instruction set, or the best supported one below it.
+  \param isa the instruction set to use
+  \return the instruction set actually selected
+ */
+KernelIsa kernel_select(KernelIsa isa);
+
+/// out[i] = a[i] op b[i] for i < n; out may alias a or b
+void kernel_vv(KernelOp op, const double * a, const double * b, double * out, std::size_t n);
+
+/// out[i] = a[i] op b for i < n; out may alias a
+void kernel_vs(KernelOp op, const double * a, double b, double * out, std::size_t n);
+
+/// out[i] = a op b[i] for i < n; out may alias b
+void kernel_sv(KernelOp op, double a, const double * b, double * out, std::size_t n);
+
+/// out[i] = sqrt(a[i]) for i < n; out may alias a
+void kernel_sqrt(const double * a, double * out, std::size_t n);
+
+#endif
@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "kernels.hpp"
+
+TEST_CASE( "Test kernels agree across instruction sets", "[kernels]" ) {
+
+  // odd length so the vector loops leave a scalar tail
+  const std::size_t n = 37;
+  std::vector<double> a(n), b(n);
+  for(std::size_t i = 0; i < n; ++i){
+    a[i] = 0.5 * i - 3.0;
+    b[i] = 1.25 + i;
+  }
+
+  std::vector<KernelIsa> isas = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+  std::vector<KernelOp> ops = {KERNEL_ADD, KERNEL_SUB, KERNEL_MUL, KERNEL_DIV};
+
+  for(auto op : ops){
+    std::vector<double> vv(n), vs(n), sv(n);
+    for(std::size_t i = 0; i < n; ++i){
+      switch(op){
+      case KERNEL_ADD: vv[i] = a[i] + b[i]; vs[i] = a[i] + 2.0; sv[i] = 2.0 + b[i]; break;
+      case KERNEL_SUB: vv[i] = a[i] - b[i]; vs[i] = a[i] - 2.0; sv[i] = 2.0 - b[i]; break;
+      case KERNEL_MUL: vv[i] = a[i] * b[i]; vs[i] = a[i] * 2.0; sv[i] = 2.0 * b[i]; break;
+      case KERNEL_DIV: vv[i] = a[i] / b[i]; vs[i] = a[i] / 2.0; sv[i] = 2.0 / b[i]; break;
+      }
+    }
+
+    for(auto isa : isas){
+      INFO(isa);
+      KernelIsa selected = kernel_select(isa);
+      REQUIRE(selected <= isa);
+      REQUIRE(kernel_isa() == selected);
+
+      std::vector<double> out(n);
+      kernel_vv(op, a.data(), b.data(), out.data(), n);
+      REQUIRE(out == vv);
+      kernel_vs(op, a.data(), 2.0, out.data(), n);
+      REQUIRE(out == vs);
+      kernel_sv(op, 2.0, b.data(), out.data(), n);
+      REQUIRE(out == sv);
+
+      // in place
+      out = a;
+      kernel_vv(op, out.data(), b.data(), out.data(), n);
+      REQUIRE(out == vv);
+    }
+  }
+
+  for(auto isa : isas){
+    kernel_select(isa);
+    std::vector<double> out(n);
+    kernel_sqrt(b.data(), out.data(), n);
+    for(std::size_t i = 0; i < n; ++i){
+      REQUIRE(out[i] == std::sqrt(b[i]));
+    }
+  }
+
+  kernel_select(KERNEL_AVX2);
+}
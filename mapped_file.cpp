@@ -0,0 +1,59 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PLOTSCRIPT_MMAP
+#endif
+
+MappedFile::MappedFile(const std::string & path): m_open(false), m_map(nullptr), m_size(0) {
+
+#ifdef PLOTSCRIPT_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat info;
+  if(::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+    void * map = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED){
+      // the tokenizer reads front to back
+      ::madvise(map, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+      m_map = map;
+      m_size = static_cast<std::size_t>(info.st_size);
+      m_open = true;
+    }
+  }
+  ::close(fd);
+  if(m_open) return;
+#endif
+
+  // empty files cannot be mapped, and other systems have no mmap: read a copy
+  std::ifstream ifs(path, std::ios::binary);
+  if(!ifs) return;
+  m_copy.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  m_size = m_copy.size();
+  m_open = true;
+}
+
+MappedFile::~MappedFile(){
+#ifdef PLOTSCRIPT_MMAP
+  if(m_map) ::munmap(m_map, m_size);
+#endif
+}
+
+bool MappedFile::isOpen() const noexcept{
+  return m_open;
+}
+
+const char * MappedFile::data() const noexcept{
+  return m_map ? static_cast<const char *>(m_map) : m_copy.data();
+}
+
+std::size_t MappedFile::size() const noexcept{
+  return m_size;
+}
@@ -0,0 +1,54 @@
+/*! \file mapped_file.hpp
+Defines the MappedFile type, a read-only view of a whole file.
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/*! \class MappedFile
+\brief The contents of a file as one contiguous, read-only buffer.
+
+On POSIX systems the file is memory-mapped, so opening it copies nothing
+and the tokenizer reads the page cache directly. Elsewhere, or if mapping
+fails, the file is read into memory once. The buffer stays valid until the
+MappedFile is destroyed, so token views into it must not outlive it.
+ */
+class MappedFile {
+public:
+
+  /// Open and map the file at path; check isOpen for success
+  explicit MappedFile(const std::string & path);
+
+  /// Unmap the file
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  /// true if the file could be opened
+  bool isOpen() const noexcept;
+
+  /// return the first character of the file
+  const char * data() const noexcept;
+
+  /// return the number of characters in the file
+  std::size_t size() const noexcept;
+
+private:
+
+  // true if the file could be opened
+  bool m_open;
+
+  // the mapped region, or nullptr if the contents are in m_copy
+  void * m_map;
+
+  // length of the file
+  std::size_t m_size;
+
+  // the contents, when the file is empty or could not be mapped
+  std::string m_copy;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "mapped_file.hpp"
+
+TEST_CASE("Test mapping a file", "[mapped_file]") {
+
+  std::string path = "mapped_file_test.pls";
+  std::string program = "(begin (define a 1) (+ a 2))";
+  {
+    std::ofstream ofs(path);
+    ofs << program;
+  }
+
+  {
+    MappedFile file(path);
+    REQUIRE(file.isOpen());
+    REQUIRE(file.size() == program.size());
+    REQUIRE(std::string(file.data(), file.size()) == program);
+  }
+
+  {
+    std::ofstream ofs(path);
+  }
+
+  {
+    MappedFile file(path);
+    REQUIRE(file.isOpen());
+    REQUIRE(file.size() == 0);
+  }
+
+  std::remove(path.c_str());
+
+  MappedFile missing("no_such_file.pls");
+  REQUIRE(!missing.isOpen());
+}
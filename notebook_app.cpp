@@ -2,8 +2,9 @@
 #include "expression.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
-#include "ThreadSafeQueue.hpp"
+#include "ring_queue.hpp"
 #include "worker.hpp"
+#include "kernel_pool.hpp"
 
 #include <QDebug>
 #include <QString>
@@ -12,8 +13,27 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <atomic>
+
+// interned key and object names of graphics objects, compared by handle
+static const SymbolId OBJECT_NAME_KEY = intern("\"object-name\"");
+static const SymbolId POINT_NAME = intern("\"point\"");
+static const SymbolId LINE_NAME = intern("\"line\"");
+static const SymbolId TEXT_NAME = intern("\"text\"");
+
+// numbers the sessions of the notebooks in this process
+static std::atomic<unsigned> next_session(0);
+
+KernelPool& NotebookApp::kernels() {
+	static KernelPool pool(startup_snapshot(), std::thread::hardware_concurrency());
+	return pool;
+}
 
 NotebookApp::NotebookApp() {
+	session = "notebook-" + std::to_string(next_session++);
+	outbox = std::make_shared<Outbox>();
+	outbox->app = this;
+
 	//Instantiate the widgets used on the notebook app
 	input = new InputWidget();
 	output = new OutputWidget();
@@ -26,9 +46,17 @@ NotebookApp::NotebookApp() {
 	QPushButton* interrupt = new QPushButton("Interrupt");
 	interrupt->setObjectName("interrupt");
 
-	//Create a worker and thread
-	Worker main_worker(&input_queue, &output_queue);
-	main_thread = std::thread(main_worker);
+	//Indeterminate progress bar shown while evaluations are outstanding
+	busy_indicator = new QProgressBar();
+	busy_indicator->setObjectName("busy");
+	busy_indicator->setRange(0, 0);
+	busy_indicator->hide();
+
+	//Results are posted by the kernel thread and shown on this one
+	QObject::connect(this, SIGNAL(resultReady()), this, SLOT(showResults()), Qt::QueuedConnection);
+
+	//Start this notebook's session
+	startKernel();
 
 	QObject::connect(input, SIGNAL(shiftEnter()), this, SLOT(NewInterpret()));
 	QObject::connect(start, SIGNAL(clicked()), this, SLOT(start_signal()));
@@ -41,6 +69,7 @@ NotebookApp::NotebookApp() {
 	b_layout->addWidget(stop);
 	b_layout->addWidget(reset);
 	b_layout->addWidget(interrupt);
+	b_layout->addWidget(busy_indicator);
 
 	buttons = new QWidget;
 	buttons->setLayout(b_layout);
@@ -54,69 +83,98 @@ NotebookApp::NotebookApp() {
 }
 
 NotebookApp::~NotebookApp() {
-	//Send the key word to end the worker's while(true) loop when the program is exited
-	input_queue.push("die");
-	main_thread.join();
+	//Results of evaluations still running are dropped once the notebook is gone
+	{
+		std::lock_guard<std::mutex> lock(outbox->mutex);
+		outbox->app = nullptr;
+	}
+	stopKernel();
+}
+
+//Starts the notebook's session. Its first input picks the least busy kernel of the pool
+void NotebookApp::startKernel() {
+	kernel_running = true;
 }
 
-//Interprets each item in a list and outputs them one at a time. 
-void NotebookApp::recursiveListInterpret(std::vector<Expression>& list) {
-	if (list.size() == 0) {
+//Stops the notebook's session, dropping its environment. Inputs the kernel has not started on report an error
+//instead of running and the one it is running is interrupted, so this does not wait for outstanding evaluations
+//to finish. Other notebooks on the same kernel are not affected
+void NotebookApp::stopKernel() {
+	if (!kernel_running) {
 		return;
 	}
 
-	Expression exp = list[0];
-	std::string evalExp = "";
-	if (exp.getProperty("\"object-name\"") == Expression(Atom("\"point\""))) {
-		output->outputPoint(exp, false);
-	}
-	else if (exp.getProperty("\"object-name\"") == Expression(Atom("\"line\""))) {
-		output->outputLine(exp, false);
-	}
-	else if (exp.getProperty("\"object-name\"") == Expression(Atom("\"text\""))) {
-		output->outputText(exp, false);
-	}
-	else {
-		evalExp = expString(exp);
-		output->outputExpression(QString::fromStdString(evalExp));
-	}
+	kernels().interrupt(session);
+	kernels().close(session);
+	kernel_running = false;
+}
+
+bool NotebookApp::isBusy() const {
+	return pending > 0;
+}
 
-	list.erase(list.begin());
-	recursiveListInterpret(list);
+//Outputs every item in a list result, such as a plot, as one batch (see OutputWidget::outputList).
+void NotebookApp::listInterpret(const std::vector<Expression>& list) {
+	output->outputList(list);
 }
 
-//Slot that gets called when shift enter is pressed. It parses the input string from the input box if the thread is active,
-//outputs an error if the thread is not active.
+//Slot that gets called when shift enter is pressed. Queues the input string from the input box for the kernel
+//if the thread is active, outputs an error if the thread is not active. The result is shown by showResults once
+//the kernel posts it, so the notebook stays responsive and more inputs can be queued meanwhile.
 void NotebookApp::NewInterpret() {
-		if (!main_thread.joinable()) {
+		if (!kernel_running) {
 			output->outputExpression(QString::fromStdString("Error: interpreter kernel not running"));
 		}
 		else {
-			std::pair<std::string, Expression> ret;
 			std::string inString = input->toPlainText().toStdString();
 
-			input->setDisabled(true);
-			input_queue.push(inString);
-			output_queue.wait_and_pop(ret);
-			input->setDisabled(false);
+			pending++;
+			busy_indicator->show();
+			std::shared_ptr<Outbox> box = outbox;
+			kernels().submit(session, std::move(inString), [box](KernelPool::Result&& ret) {
+				//Called on the kernel thread; the result is shown on the GUI thread by showResults
+				std::lock_guard<std::mutex> lock(box->mutex);
+				if (box->app) {
+					box->app->output_queue.push(std::move(ret));
+					emit box->app->resultReady();
+				}
+			});
+		}
+		
+}
+
+//Slot that gets called, on the GUI thread, after a kernel pushes a result. Shows every result available.
+void NotebookApp::showResults() {
+	std::pair<std::string, Expression> ret;
+	while (output_queue.try_pop(ret)) {
+		if (pending > 0) pending--;
+		showResult(ret);
+	}
 
+	if (pending == 0) {
+		busy_indicator->hide();
+	}
+}
+
+//Outputs one result from the kernel: an expression, graphics, or an error message
+void NotebookApp::showResult(std::pair<std::string, Expression>& ret) {
 			if (ret.first.empty()) { //output expression
 				Expression exp = ret.second;
 				std::string evalExp = "";
 
-				if (exp.getProperty("\"object-name\"") == Expression(Atom("\"point\""))) {
+				SymbolId name = exp.getProperty(OBJECT_NAME_KEY).head().asSymbolId();
+
+				if (name == POINT_NAME) {
 					output->outputPoint(exp, true);
 				}
-				else if (exp.getProperty("\"object-name\"") == Expression(Atom("\"line\""))) {
+				else if (name == LINE_NAME) {
 					output->outputLine(exp, true);
 				}
-				else if (exp.getProperty("\"object-name\"") == Expression(Atom("\"text\""))) {
+				else if (name == TEXT_NAME) {
 					output->outputText(exp, true);
 				}
-				else if (exp.head().asSymbol() == "list") {
-					output->clear();
-					std::vector<Expression> list = exp.getTail();
-					recursiveListInterpret(list);
+				else if (exp.isHeadList()) {
+					listInterpret(exp.unpackTail());
 				}
 				else if (!exp.isHeadLambda()) {
 					evalExp = expString(exp);
@@ -130,44 +188,29 @@ void NotebookApp::NewInterpret() {
 				std::string errorMessage = ret.first;
 				output->outputExpression(QString::fromStdString(errorMessage));
 			}
-
-		}
-		
 }
 
-//Slot gets called when the Start Kernel button is pressed. This starts a new thread if the current one is inactive.
+//Slot gets called when the Start Kernel button is pressed. This starts a new session if the current one is inactive.
 void NotebookApp::start_signal() {
-	if (!main_thread.joinable()) {
-		Worker new_worker(&input_queue, &output_queue);
-		main_thread = std::thread(new_worker);
+	if (!kernel_running) {
+		startKernel();
 	}
 }
 
-//Slot gets called when the Stop Kernel button is pressed. Kills the thread if it is active.
+//Slot gets called when the Stop Kernel button is pressed. Closes the session if it is active.
 void NotebookApp::stop_signal() {
-	if (main_thread.joinable()) {
-		input_queue.push("die");
-		main_thread.join();
-	}
+	stopKernel();
 }
 
 //Slot gets called when the Reset Kernel button is pressed. 
 void NotebookApp::reset_signal() {
-
-	if (main_thread.joinable()) {
-		input_queue.push("die");
-		main_thread.join();
-		Worker new_worker(&input_queue, &output_queue);
-		main_thread = std::thread(new_worker);
-	}
-	else{
-		Worker new_worker(&input_queue, &output_queue);
-		main_thread = std::thread(new_worker);
-	}
-	
+	stopKernel();
+	startKernel();
 }
 
+//Slot gets called when the Interrupt button is pressed. Stops the evaluation in progress, if any, and the inputs
+//queued before the press, even if the kernel has not started on them yet; the kernel reports an error for each
+//and keeps running with its environment intact.
 void NotebookApp::interrupt_signal() {
-
-	
+	kernels().interrupt(session);
 }
\ No newline at end of file
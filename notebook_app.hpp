@@ -4,35 +4,49 @@
 #include <QWidget>
 #include <QLayout>
 #include <QPushButton>
+#include <QProgressBar>
 #include <fstream>
-#include <thread>
+#include <memory>
+#include <mutex>
+#include <string>
 
 #include "input_widget.hpp"
 #include "output_widget.hpp"
 #include "interpreter.hpp"
 #include "expression.hpp"
-#include "ThreadSafeQueue.hpp"
-#include "worker.hpp"
+#include "kernel_pool.hpp"
+#include "ring_queue.hpp"
 
 //NotebookApp is the top level widget used in the gui for the plotscript project.
 //It has 4 horizontal push buttons along the top, underneath of them an inputwidget to input text,
 //and under that an outputwidget to show the result of a plotscript evaluation (or kernel error).
 //There are 4 slots in the widget, one for when shift-enter is pressed by the inputwidget to evaluate an expression
-//and one for each push button.
+//and one for each push button. Evaluation is asynchronous: each notebook is a session of a kernel pool shared by
+//every notebook in the process (see KernelPool), which signals resultReady for each result, and a busy indicator
+//next to the buttons shows while results are outstanding.
 class NotebookApp: public QWidget{
 Q_OBJECT
 
 public:
 	NotebookApp();
 	~NotebookApp();
-	void recursiveListInterpret(std::vector<Expression>& list);
+	void listInterpret(const std::vector<Expression>& list);
 
-	ThreadSafeQueue<std::string> input_queue;
-	ThreadSafeQueue<std::pair<std::string, Expression>> output_queue;
-	std::thread main_thread;
+	//True while results of queued evaluations are outstanding
+	bool isBusy() const;
+
+	RingQueue<std::pair<std::string, Expression>> output_queue;
+
+	//The kernels shared by every notebook, one per core, forked from the startup environment
+	static KernelPool& kernels();
+
+signals:
+	//Emitted from the kernel thread each time it pushes a result
+	void resultReady();
 
 public slots:
 	void NewInterpret();
+	void showResults();
 	void start_signal();
 	void stop_signal();
 	void reset_signal();
@@ -42,6 +56,25 @@ private:
 	InputWidget* input;
 	OutputWidget* output;
 	QWidget* buttons;
+	QProgressBar* busy_indicator;
+
+	//Number of queued evaluations whose results have not been shown
+	int pending = 0;
+
+	//The id of this notebook's session in the pool, and whether its kernel is started
+	std::string session;
+	bool kernel_running = false;
+
+	//Shared with the callbacks of queued evaluations, which may finish after the notebook is closed
+	struct Outbox {
+		std::mutex mutex;
+		NotebookApp* app;
+	};
+	std::shared_ptr<Outbox> outbox;
+
+	void startKernel();
+	void stopKernel();
+	void showResult(std::pair<std::string, Expression>& ret);
 };
 
 #endif
\ No newline at end of file
@@ -32,6 +32,8 @@ private slots:
   void testDiscretePlotLayout();
   void testContinuousPlotLayout();
   void startStopKernelTest();
+  void stopDuringEvaluationTest();
+  void largePlotRender();
 
 private:
 
@@ -62,6 +64,7 @@ void NotebookTest::GetPropertyNoneCase() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -79,6 +82,7 @@ void NotebookTest::cosPi() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -96,6 +100,7 @@ void NotebookTest::complexInput() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -116,6 +121,7 @@ void NotebookTest::listOfPoints() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -135,6 +141,7 @@ void NotebookTest::listOfLines() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -152,6 +159,7 @@ void NotebookTest::eIPi() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -172,6 +180,7 @@ void NotebookTest::theTitle() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -188,6 +197,7 @@ void NotebookTest::lambdaNoOutput() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -204,6 +214,7 @@ void NotebookTest::defaultPointSize() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -224,6 +235,7 @@ void NotebookTest::listPointTextAndLine() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -241,6 +253,7 @@ void NotebookTest::errorTest() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -259,6 +272,7 @@ void NotebookTest::listTest() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
 
@@ -282,6 +296,7 @@ void NotebookTest::Milestone3Task1() {
 	inputWidget->insertPlainText(testInput);
 
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
 	QVERIFY2(textItem, "Could not find text item");
@@ -382,6 +397,7 @@ void NotebookTest::testDiscretePlotLayout() {
 
 	inputWidget->setPlainText(QString::fromStdString(program));
 	QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	auto view = outputWidget->findChild<QGraphicsView *>();
 	QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
@@ -466,6 +482,7 @@ void NotebookTest::testContinuousPlotLayout() {
 
 	inputWidget->setPlainText(QString::fromStdString(program));
 	QTest::keyClick(inputWidget, Qt::Key_Return, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	auto view = outputWidget->findChild<QGraphicsView *>();
 	QVERIFY2(view, "Could not find QGraphicsView as child of OutputWidget");
@@ -547,6 +564,7 @@ void NotebookTest::startStopKernelTest() {
 
 	//Hit shift-enter to attempt to evaluate expression
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	//Since the kernel is stopped, the output should read "Error: interpreter kernel not running"
 	QGraphicsTextItem* textItem = outputWidget->getTextItem();
@@ -559,6 +577,7 @@ void NotebookTest::startStopKernelTest() {
 
 	//Hit shift-enter to attempt to evaluate expression again
 	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTRY_VERIFY(!test_app.isBusy());
 
 	//Since the kernel is running again, it should evaluate the expression this time, reading "(3)"
 	QGraphicsTextItem* textItem2 = outputWidget->getTextItem();
@@ -568,6 +587,48 @@ void NotebookTest::startStopKernelTest() {
 }
 
 
+void NotebookTest::stopDuringEvaluationTest() {
+	//A program that only an interrupt stops
+	QString testInput = "(begin (define f (lambda (n) (f n))) (f 0))";
+	inputWidget->insertPlainText(testInput);
+
+	QPushButton* stop = test_app.findChild<QPushButton*>("stop");
+	QVERIFY2(stop, "Could not find stop button");
+	QPushButton* start = test_app.findChild<QPushButton*>("start");
+	QVERIFY2(start, "Could not find start button");
+
+	//Stop the kernel right after queuing the input, while the kernel is just starting on it.
+	//The evaluation must still be stopped, so the notebook does not stay busy
+	QTest::keyClick(inputWidget, Qt::Key_Enter, Qt::ShiftModifier);
+	QTest::mouseClick(stop, Qt::LeftButton);
+	QTRY_VERIFY(!test_app.isBusy());
+
+	QGraphicsTextItem* textItem = outputWidget->getTextItem();
+	QVERIFY2(textItem, "Could not find text item");
+	QString output = textItem->toPlainText();
+	QVERIFY(output == "Error: interpreter kernel interrupted" || output == "Error: session closed");
+
+	QTest::mouseClick(start, Qt::LeftButton);
+}
+
+void NotebookTest::largePlotRender() {
+	//A list of 50000 points is drawn as one batch, so rendering is linear in the number of points
+	std::vector<Expression> points;
+	for (int i = 0; i < 50000; ++i) {
+		Expression point(std::vector<Expression>{ Expression(Atom(i)), Expression(Atom(i)) });
+		point.setProperty("\"object-name\"", Expression(Atom("\"point\"")));
+		point.setProperty("\"size\"", Expression(Atom(0.0)));
+		points.push_back(point);
+	}
+
+	int fits = outputWidget->fits;
+	outputWidget->outputList(points);
+
+	//Every point is drawn and the view is fitted once for the whole list, not once per point
+	QGraphicsView* qgv = outputWidget->findChild<QGraphicsView*>();
+	QCOMPARE(qgv->scene()->items().size(), 50000);
+	QCOMPARE(outputWidget->fits - fits, 1);
+}
 
 QTEST_MAIN(NotebookTest)
 #include "notebook_test.moc"
@@ -17,6 +17,18 @@
 #include <QDebug>
 #include <iostream>
 
+// interned property keys and object names of graphics objects, so drawing
+// a plot compares handles rather than strings
+static const SymbolId OBJECT_NAME_KEY = intern("\"object-name\"");
+static const SymbolId SIZE_KEY = intern("\"size\"");
+static const SymbolId THICKNESS_KEY = intern("\"thickness\"");
+static const SymbolId POSITION_KEY = intern("\"position\"");
+static const SymbolId TEXT_SCALE_KEY = intern("\"text-scale\"");
+static const SymbolId TEXT_ROTATION_KEY = intern("\"text-rotation\"");
+static const SymbolId POINT_NAME = intern("\"point\"");
+static const SymbolId LINE_NAME = intern("\"line\"");
+static const SymbolId TEXT_NAME = intern("\"text\"");
+
 OutputWidget::OutputWidget(QWidget * parent) : QWidget(parent) {
 	QString name = QString::fromStdString("output");
 	setObjectName(name);
@@ -35,119 +47,194 @@ void OutputWidget::outputExpression(QString input) {
 	qgs->addItem(qgti);
 }
 
-//When a point is needing to be drawn on the scene this function gets called.
-//param clearFlag indicates whether the scene needs to be cleared first.
-void OutputWidget::outputPoint(Expression& exp, bool clearFlag) {
-	if(clearFlag) clear();
-
+//Builds the item for a make-point expression, or returns nullptr and sets error.
+QGraphicsItem* OutputWidget::makePoint(Expression& exp, QString& error) {
 	//Get the parameters from the make-point expression
-	qreal width = exp.getProperty("\"size\"").head().asNumber();
+	qreal width = exp.getProperty(SIZE_KEY).head().asNumber();
 	qreal height = width;
-	qreal x = exp.getTail().at(0).head().asNumber();
+	qreal x = exp.tailAt(0).head().asNumber();
 	x = x - (width / 2);
-	qreal y = exp.getTail().at(1).head().asNumber();
+	qreal y = exp.tailAt(1).head().asNumber();
 	y = y - (width / 2);
 
 	//Error if the point's width is negative
 	if (width < 0) {
-		outputExpression(QString::fromStdString("Error: point size cannot be negative"));
+		error = QString::fromStdString("Error: point size cannot be negative");
+		return nullptr;
 	}
-	else {
-		QGraphicsEllipseItem* point = new QGraphicsEllipseItem(x, y, width, height);
-		QBrush brush(Qt::SolidPattern);
-		point->setBrush(brush);
-		point->setScale(1);
-		point->setPen(Qt::NoPen);
-		qgs->addItem(point);
-
-		qgv->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->fitInView(qgs->itemsBoundingRect(), Qt::KeepAspectRatio);
+
+	QGraphicsEllipseItem* point = new QGraphicsEllipseItem(x, y, width, height);
+	QBrush brush(Qt::SolidPattern);
+	point->setBrush(brush);
+	point->setScale(1);
+	point->setPen(Qt::NoPen);
+	return point;
+}
+
+//Builds the item for a make-line expression, or returns nullptr and sets error.
+QGraphicsItem* OutputWidget::makeLine(Expression& exp, QString& error) {
+	int thickness = exp.getProperty(THICKNESS_KEY).head().asNumber();
+
+	if (thickness < 0) {
+		error = QString::fromStdString("Error: line thickness cannot be negative");
+		return nullptr;
+	}
+
+	qreal x1 = exp.tailAt(0).tailAt(0).head().asNumber();
+	qreal x2 = exp.tailAt(1).tailAt(0).head().asNumber();
+	qreal y1 = exp.tailAt(0).tailAt(1).head().asNumber();
+	qreal y2 = exp.tailAt(1).tailAt(1).head().asNumber();
+
+	QGraphicsLineItem* line = new QGraphicsLineItem(x1, y1, x2, y2);
+
+	QPen pen(Qt::SolidLine);
+	pen.setWidth(thickness);
+	line->setPen(pen);
+	line->setScale(1);
+	return line;
+}
+
+//Builds the item for a make-text expression, or returns nullptr and sets error.
+QGraphicsItem* OutputWidget::makeText(Expression& exp, QString& error) {
+	Expression position = exp.getProperty(POSITION_KEY);
+
+	if (!position.isHeadList() || position.tailLength() != 2) {
+		error = QString::fromStdString("Error: position must be a point");
+		return nullptr;
+	}
+
+	std::string temp = exp.head().asString();
+	temp.erase(0, 1);
+	temp.erase(temp.length() - 1, 1);
+	QString text = QString::fromStdString(temp);
+	qgti = new QGraphicsTextItem(text);
+
+	double scaleFactor = exp.getProperty(TEXT_SCALE_KEY).head().asNumber();
+	double textRotation = exp.getProperty(TEXT_ROTATION_KEY).head().asNumber();
+
+	auto font = QFont("Monospace");
+	font.setStyleHint(QFont::TypeWriter);
+	font.setPointSize(1);
+	qgti->setFont(font);
+	qgti->setScale(scaleFactor);
+
+	double centerX = position.tailAt(0).head().asNumber();
+	double centerY = position.tailAt(1).head().asNumber();
+	qreal defaultWidth = qgti->boundingRect().width();
+	qreal defaultHeight = qgti->boundingRect().height();
+
+	qgti->setPos(QPointF(centerX - (defaultWidth / 2), centerY - (defaultHeight / 2)));
+
+	if (-qRadiansToDegrees(textRotation) == -90) {
+		qgti->setTransformOriginPoint(defaultWidth /2, defaultHeight /2);
 	}
+	qgti->setRotation(-qRadiansToDegrees(textRotation));
+
+	return qgti;
 }
 
-//When a line is needing to be drawn on the scene this function gets called.
+//Scales the view so the whole scene is visible. This is O(n) in the scene, so call it once per result.
+void OutputWidget::fitView() {
+	qgv->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+	qgv->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+	qgv->fitInView(qgs->itemsBoundingRect(), Qt::KeepAspectRatio);
+	fits++;
+}
+
+//Adds a single graphics item to the scene, or shows the error if it could not be built.
 //param clearFlag indicates whether the scene needs to be cleared first.
-void OutputWidget::outputLine(Expression& exp, bool clearFlag) {
+void OutputWidget::outputItem(QGraphicsItem* item, const QString& error, bool clearFlag) {
 	if (clearFlag) clear();
 
-	int thickness = exp.getProperty("\"thickness\"").head().asNumber();
-
-	if (thickness < 0) {
-		outputExpression(QString::fromStdString("Error: line thickness cannot be negative"));
+	if (item == nullptr) {
+		outputExpression(error);
 	}
 	else {
-		qreal x1 = exp.getTail().at(0).getTail().at(0).head().asNumber();
-		qreal x2 = exp.getTail().at(1).getTail().at(0).head().asNumber();
-		qreal y1 = exp.getTail().at(0).getTail().at(1).head().asNumber();
-		qreal y2 = exp.getTail().at(1).getTail().at(1).head().asNumber();
-
-		QGraphicsLineItem* line = new QGraphicsLineItem(x1, y1, x2, y2);
-
-		QPen pen(Qt::SolidLine);
-		pen.setWidth(thickness);
-		line->setPen(pen);
-		line->setScale(1);
-		qgs->addItem(line);
-
-		qgv->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->fitInView(qgs->itemsBoundingRect(), Qt::KeepAspectRatio);
+		qgs->addItem(item);
+		fitView();
 	}
+}
+
+//When a point is needing to be drawn on the scene this function gets called.
+//param clearFlag indicates whether the scene needs to be cleared first.
+void OutputWidget::outputPoint(Expression& exp, bool clearFlag) {
+	QString error;
+	QGraphicsItem* item = makePoint(exp, error);
+	outputItem(item, error, clearFlag);
+}
 
+//When a line is needing to be drawn on the scene this function gets called.
+//param clearFlag indicates whether the scene needs to be cleared first.
+void OutputWidget::outputLine(Expression& exp, bool clearFlag) {
+	QString error;
+	QGraphicsItem* item = makeLine(exp, error);
+	outputItem(item, error, clearFlag);
 }
 
 //When any text is needing to be drawn on the scene this function gets called.
 //param clearFlag indicates whether the scene needs to be cleared first.
 void OutputWidget::outputText(Expression& exp, bool clearFlag) {
-	if(clearFlag) clear();
-
-	Atom shouldBeList = exp.getProperty("\"position\"").head();
-	std::vector<Expression> point = exp.getProperty("\"position\"").getTail();
+	QString error;
+	QGraphicsItem* item = makeText(exp, error);
+	outputItem(item, error, clearFlag);
+}
 
-	if (shouldBeList != Atom("list") || point.size() != 2) {
-		outputExpression(QString::fromStdString("Error: position must be a point"));
-	}
-	else {
-		std::string temp = exp.head().asString();
-		temp.erase(0, 1);
-		temp.erase(temp.length() - 1, 1);
-		QString text = QString::fromStdString(temp);
-		qgti = new QGraphicsTextItem(text);
-
-		double scaleFactor = exp.getProperty("\"text-scale\"").head().asNumber();
-		double textRotation = exp.getProperty("\"text-rotation\"").head().asNumber();
-
-		auto font = QFont("Monospace");
-		font.setStyleHint(QFont::TypeWriter);
-		font.setPointSize(1);
-		qgti->setFont(font);
-		qgti->setScale(scaleFactor);
-
-		double centerX = point.at(0).head().asNumber();
-		double centerY = point.at(1).head().asNumber();
-		qreal defaultWidth = qgti->boundingRect().width();
-		qreal defaultHeight = qgti->boundingRect().height();
-
-		qgti->setPos(QPointF(centerX - (defaultWidth / 2), centerY - (defaultHeight / 2)));
-
-		if (-qRadiansToDegrees(textRotation) == -90) {
-			qgti->setTransformOriginPoint(defaultWidth /2, defaultHeight /2);
-			qgti->setRotation(-qRadiansToDegrees(textRotation));
+//Draws every element of a list result, such as a plot, in one pass. Items are built first and added to the scene
+//with its index disabled, then the view is fitted once, so this is linear in the size of the list. The result is
+//the same as outputting the elements one at a time: an element that is not graphics, or an error, replaces
+//everything before it.
+void OutputWidget::outputList(const std::vector<Expression>& list) {
+	std::vector<QGraphicsItem*> items;
+	items.reserve(list.size());
+	bool graphics = false;
+
+	//drops the items built so far, for a result that replaces them
+	auto restart = [&items, &graphics](QGraphicsItem* item) {
+		for (QGraphicsItem* old : items) delete old;
+		items.clear();
+		items.push_back(item);
+		graphics = false;
+	};
+
+	for (Expression exp : list) {
+		SymbolId name = exp.getProperty(OBJECT_NAME_KEY).head().asSymbolId();
+		QString error;
+		QGraphicsItem* item = nullptr;
+
+		if (name == POINT_NAME) {
+			item = makePoint(exp, error);
+		}
+		else if (name == LINE_NAME) {
+			item = makeLine(exp, error);
+		}
+		else if (name == TEXT_NAME) {
+			item = makeText(exp, error);
 		}
 		else {
-			qgti->setRotation(-qRadiansToDegrees(textRotation));
+			error = QString::fromStdString(expString(exp));
 		}
 
-		qgs->addItem(qgti);
-
-		qgv->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-		qgv->fitInView(qgs->itemsBoundingRect(), Qt::KeepAspectRatio);
-
+		if (item != nullptr) {
+			items.push_back(item);
+			graphics = true;
+		}
+		else {
+			qgti = new QGraphicsTextItem(error);
+			restart(qgti);
+		}
 	}
 
+	clear();
+	QGraphicsScene::ItemIndexMethod index = qgs->itemIndexMethod();
+	qgs->setItemIndexMethod(QGraphicsScene::NoIndex);
+	for (QGraphicsItem* item : items) {
+		qgs->addItem(item);
+	}
+	qgs->setItemIndexMethod(index);
 
+	if (graphics) {
+		fitView();
+	}
 }
 
 void OutputWidget::clear() {
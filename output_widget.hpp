@@ -4,11 +4,14 @@
 #include <QWidget>
 #include <QString>
 
+#include <vector>
+
 #include "expression.hpp"
 
 class QGraphicsView;
 class QGraphicsScene;
 class QGraphicsTextItem;
+class QGraphicsItem;
 
 //Output Widget is a class that shows a QGraphicsView and QGraphicsScene containing the result
 //of a plotscript command. It uses composition to show its members.
@@ -22,6 +25,7 @@ public:
 	void outputPoint(Expression& exp, bool clearFlag);
 	void outputLine(Expression& exp, bool clearFlag);
 	void outputText(Expression& exp, bool clearFlag);
+	void outputList(const std::vector<Expression>& list);
 	void clear();
 	QGraphicsTextItem* getTextItem();
 
@@ -34,6 +38,17 @@ private:
 	QGraphicsScene * qgs;
 	QGraphicsTextItem * qgti;
 
+	//Item builders, each returns nullptr and sets error if the expression cannot be drawn
+	QGraphicsItem* makePoint(Expression& exp, QString& error);
+	QGraphicsItem* makeLine(Expression& exp, QString& error);
+	QGraphicsItem* makeText(Expression& exp, QString& error);
+
+	void outputItem(QGraphicsItem* item, const QString& error, bool clearFlag);
+	void fitView();
+
+	//Number of times the view has been fitted, so tests can check a result is fitted once
+	int fits = 0;
+
 };
 
 #endif
\ No newline at end of file
@@ -1,26 +1,44 @@
 #include "parse.hpp"
 
+#include <cstring>
 #include <stack>
 
-bool setHead(Expression &exp, const Token &token) {
+// builds the Atom for an owned Token
+struct TokenAtoms {
+  Token::TokenType type(const Token &token) const { return token.type(); }
+  Atom atom(const Token &token) const { return Atom(token); }
+};
+
+// builds the Atom for a TokenView into a buffer
+struct TokenViewAtoms {
+  const char *buffer;
+  Token::TokenType type(const TokenView &token) const { return token.type; }
+  Atom atom(const TokenView &token) const { return Atom(token, buffer); }
+};
 
-  Atom a(token);
+template <typename T, typename Atoms>
+bool setHead(Expression &exp, const T &token, const Atoms &atoms) {
+
+  Atom a = atoms.atom(token);
 
   exp.head() = a;
 
   return !a.isNone();
 }
 
-bool append(Expression *exp, const Token &token) {
+template <typename T, typename Atoms>
+bool append(Expression *exp, const T &token, const Atoms &atoms) {
 
-  Atom a(token);
+  Atom a = atoms.atom(token);
 
   exp->append(a);
 
   return !a.isNone();
 }
 
-Expression parse(const TokenSequenceType &tokens) noexcept {
+// the parser, for either kind of token sequence
+template <typename Sequence, typename Atoms>
+Expression parseTokens(const Sequence &tokens, const Atoms &atoms) noexcept {
 
   Expression ast;
 
@@ -37,9 +55,9 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 
   for (auto &t : tokens) {
 
-    if (t.type() == Token::OPEN) {
+    if (atoms.type(t) == Token::OPEN) {
       athead = true;
-    } else if (t.type() == Token::CLOSE) {
+    } else if (atoms.type(t) == Token::CLOSE) {
       if (stack.empty()) {
         return Expression();
       }
@@ -53,7 +71,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 
       if (athead) {
         if (stack.empty()) {
-          if (!setHead(ast, t)) {
+          if (!setHead(ast, t, atoms)) {
             return Expression();
           }
           stack.push(&ast);
@@ -62,7 +80,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
             return Expression();
           }
 
-          if (!append(stack.top(), t)) {
+          if (!append(stack.top(), t, atoms)) {
             return Expression();
           }
           stack.push(stack.top()->tail());
@@ -73,7 +91,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
           return Expression();
         }
 
-        if (!append(stack.top(), t)) {
+        if (!append(stack.top(), t, atoms)) {
           return Expression();
         }
       }
@@ -86,4 +104,162 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
   }
 
   return Expression();
-};
+}
+
+Expression parse(const TokenSequenceType &tokens) noexcept {
+  return parseTokens(tokens, TokenAtoms());
+}
+
+Expression parse(const char *buffer, const TokenViewSequenceType &tokens) noexcept {
+  return parseTokens(tokens, TokenViewAtoms{buffer});
+}
+
+// characters read from a stream at a time
+static const std::size_t CHUNK_SIZE = 1 << 16;
+
+StreamParser::StreamParser(std::istream &input)
+    : m_input(&input), m_chunk(CHUNK_SIZE), m_pos(nullptr), m_end(nullptr),
+      m_classes(char_class_table()), m_failed(false) {}
+
+StreamParser::StreamParser(const char *buffer, std::size_t size)
+    : m_input(nullptr), m_pos(buffer), m_end(buffer + size),
+      m_classes(char_class_table()), m_failed(false) {}
+
+bool StreamParser::fill() {
+  if (m_input == nullptr || !*m_input) {
+    return false;
+  }
+  m_input->read(m_chunk.data(), m_chunk.size());
+  std::streamsize count = m_input->gcount();
+  m_pos = m_chunk.data();
+  m_end = m_pos + count;
+  return count > 0;
+}
+
+bool StreamParser::skip() {
+  while (true) {
+    if (m_pos == m_end && !fill()) {
+      return false;
+    }
+    if (*m_pos == ';') {
+      // chomp until the end of the line, which may be chunks away
+      const char *eol;
+      while ((eol = static_cast<const char *>(
+                  std::memchr(m_pos, '\n', m_end - m_pos))) == nullptr) {
+        m_pos = m_end;
+        if (!fill()) {
+          return false;
+        }
+      }
+      m_pos = eol + 1;
+    } else if (m_classes[static_cast<unsigned char>(*m_pos)] == CHAR_SPACE) {
+      ++m_pos;
+    } else {
+      return true;
+    }
+  }
+}
+
+Atom StreamParser::readAtom() {
+  const char *start = m_pos;
+  bool quoted = (*m_pos == '"');
+  bool instring = false;
+  m_token.clear();
+
+  while (true) {
+    if (m_pos == m_end) {
+      // the token continues in the next chunk
+      m_token.append(start, m_end);
+      if (!fill()) {
+        start = m_pos;
+        break;
+      }
+      start = m_pos;
+    }
+    if (instring) {
+      // the string runs to the closing quote, which ends the token
+      const char *close =
+          static_cast<const char *>(std::memchr(m_pos, '"', m_end - m_pos));
+      if (close == nullptr) {
+        m_pos = m_end;
+        continue;
+      }
+      m_pos = close + 1;
+      break;
+    }
+    if (m_classes[static_cast<unsigned char>(*m_pos)] == CHAR_PLAIN) {
+      ++m_pos;
+    } else if (*m_pos == '"') {
+      instring = true;
+      ++m_pos;
+    } else {
+      break;
+    }
+  }
+
+  // a token within one chunk is read in place, a split one from m_token
+  if (m_token.empty()) {
+    TokenView view = {quoted ? Token::QUOTE : Token::STRING, 0,
+                      static_cast<std::size_t>(m_pos - start)};
+    return Atom(view, start);
+  }
+  m_token.append(start, m_pos);
+  TokenView view = {quoted ? Token::QUOTE : Token::STRING, 0, m_token.size()};
+  return Atom(view, m_token.data());
+}
+
+StreamParser::Status StreamParser::next(Expression &form) {
+
+  if (m_failed) {
+    return ERROR;
+  }
+
+  m_stack.clear();
+  bool athead = false;
+
+  while (true) {
+    if (!skip()) {
+      if (m_stack.empty() && !athead) {
+        return END;
+      }
+      break;
+    }
+
+    if (*m_pos == '(') {
+      if (athead) {
+        break;
+      }
+      athead = true;
+      ++m_pos;
+    } else if (*m_pos == ')') {
+      if (athead || m_stack.empty()) {
+        break;
+      }
+      ++m_pos;
+      Expression node = m_stack.back();
+      m_stack.pop_back();
+      if (m_stack.empty()) {
+        form = node;
+        return FORM;
+      }
+      m_stack.back().append(node);
+    } else {
+      Atom a = readAtom();
+      if (a.isNone()) {
+        break;
+      }
+      if (athead) {
+        m_stack.emplace_back(a);
+        athead = false;
+      } else if (m_stack.empty()) {
+        break;
+      } else {
+        m_stack.back().append(a);
+      }
+    }
+  }
+
+  m_failed = true;
+  m_stack.clear();
+  return ERROR;
+}
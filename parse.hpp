@@ -4,6 +4,11 @@ Defines the parse function.
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
 #include "token.hpp"
 #include "expression.hpp"
 
@@ -15,4 +20,79 @@ Defines the parse function.
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \fn parse
+\brief parse a sequence of token views into an expression (abstract syntax tree)
+
+\param buffer, the characters the tokens were read from
+\param tokens, the input token views into buffer
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const char * buffer, const TokenViewSequenceType & tokens) noexcept;
+
+/*! \class StreamParser
+\brief Parses top-level forms straight from characters, one form at a time.
+
+Builds each Expression as its characters are read, with no token container
+in between, so memory is bounded by the largest single form rather than by
+the input. A stream is read in fixed-size chunks; a buffer (such as a
+MappedFile) is read in place. Accepts the same forms as tokenize and parse:
+a form is "(", a head atom, any atoms or forms, then ")".
+ */
+class StreamParser {
+public:
+
+  /*! \enum Status
+    \brief the outcome of reading the next form
+   */
+  enum Status { FORM,  //< a form was read
+                END,   //< only whitespace and comments remained
+                ERROR  //< the input is not a valid program
+  };
+
+  /// Construct a parser reading from a stream, which must outlive it
+  explicit StreamParser(std::istream & input);
+
+  /// Construct a parser reading a buffer in place, which must outlive it
+  StreamParser(const char * buffer, std::size_t size);
+
+  /*! Read the next top-level form
+    \param form set to the form read when the result is FORM
+    \return the outcome, which stays ERROR once an error is seen
+   */
+  Status next(Expression & form);
+
+private:
+
+  // the stream read from, or nullptr when parsing a buffer
+  std::istream * m_input;
+
+  // the characters of the current chunk, when reading a stream
+  std::vector<char> m_chunk;
+
+  // the unread characters of the current chunk or buffer
+  const char * m_pos;
+  const char * m_end;
+
+  // the start of a token split over a chunk boundary, reused between tokens
+  std::string m_token;
+
+  // the forms being built, innermost last
+  std::vector<Expression> m_stack;
+
+  // class of every char, see CharClass
+  const CharClass * m_classes;
+
+  // true once an error has been seen
+  bool m_failed;
+
+  // read the next chunk of the stream, false at the end of input
+  bool fill();
+
+  // skip whitespace and comments, false at the end of input
+  bool skip();
+
+  // read a STRING or QUOTE token into an Atom
+  Atom readAtom();
+};
+
 #endif
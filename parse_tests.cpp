@@ -2,6 +2,10 @@
 
 #include "parse.hpp"
 
+#include <sstream>
+#include <string>
+#include <vector>
+
 TEST_CASE("Test parser with expected input", "[parse]") {
 
   std::string program = "(begin (define r 10) (* pi (* r r)))";
@@ -68,3 +72,67 @@ TEST_CASE("Test string parse", "[parse]") {
 	REQUIRE(parse(tokens) != Expression());
 }
 
+TEST_CASE("Test stream parser reads forms one at a time", "[parse]") {
+
+  std::string program = "(define a 1) ; first\n(define s \"x (y) ; z\")\n(+ a (* 2 3.5))  ";
+
+  std::istringstream iss(program);
+  StreamParser parser(iss);
+
+  std::vector<std::string> forms = {"(define a 1)", "(define s \"x (y) ; z\")", "(+ a (* 2 3.5))"};
+  for (auto &text : forms) {
+    std::istringstream form(text);
+    Expression exp;
+    REQUIRE(parser.next(exp) == StreamParser::FORM);
+    REQUIRE(exp == parse(tokenize(form)));
+  }
+
+  Expression exp;
+  REQUIRE(parser.next(exp) == StreamParser::END);
+  REQUIRE(parser.next(exp) == StreamParser::END);
+
+  StreamParser buffer(program.data(), program.size());
+  REQUIRE(buffer.next(exp) == StreamParser::FORM);
+  REQUIRE(buffer.next(exp) == StreamParser::FORM);
+  REQUIRE(buffer.next(exp) == StreamParser::FORM);
+  REQUIRE(buffer.next(exp) == StreamParser::END);
+}
+
+TEST_CASE("Test stream parser across chunk boundaries", "[parse]") {
+
+  // long enough that comments, symbols and strings span the stream's chunks
+  std::string comment(70000, 'c');
+  std::string symbol(70000, 's');
+  std::string str = "\"" + std::string(70000, 't') + "\"";
+  std::string program = ";" + comment + "\n(list " + symbol + " " + str + " 12345)";
+
+  std::istringstream iss(program);
+  StreamParser parser(iss);
+
+  Expression exp;
+  REQUIRE(parser.next(exp) == StreamParser::FORM);
+  REQUIRE(exp.head().asSymbol() == "list");
+  REQUIRE(exp.tailLength() == 3);
+  REQUIRE(exp.getTail()[0].head().asSymbol() == symbol);
+  REQUIRE(exp.getTail()[1].head().asString() == str);
+  REQUIRE(exp.getTail()[2].head().asNumber() == 12345);
+  REQUIRE(parser.next(exp) == StreamParser::END);
+}
+
+TEST_CASE("Test stream parser errors", "[parse]") {
+
+  std::vector<std::string> programs = {"()", "( )", ")", "hello", "(a", "(a b))", "((a)", "(a 1abc)", "(a) b"};
+
+  for (auto &program : programs) {
+    INFO(program);
+    std::istringstream iss(program);
+    StreamParser parser(iss);
+
+    Expression exp;
+    StreamParser::Status status;
+    while ((status = parser.next(exp)) == StreamParser::FORM) {
+    }
+    REQUIRE(status == StreamParser::ERROR);
+    REQUIRE(parser.next(exp) == StreamParser::ERROR);
+  }
+}
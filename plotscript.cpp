@@ -3,24 +3,57 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <atomic>
+#include <cstdlib>
 #include <csignal>
+#include <chrono>
+#include <vector>
 
 #include "interpreter.hpp"
+#include "interrupt.hpp"
+#include "ast_cache.hpp"
+#include "parse.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
+#include "ring_queue.hpp"
 #include "ThreadSafeQueue.hpp"
 #include "worker.hpp"
+#include "kernel_pool.hpp"
+#include "batch.hpp"
 
 std::thread main_thread; //Global thread
+Interrupt interrupt; //Stops the kernel's current evaluation, shared with every kernel started
+std::atomic<bool> busy(false); //True while the REPL waits for the kernel to finish an evaluation
+
+//Ctrl-C interrupts the running evaluation instead of killing the program
+void interrupt_handler(int signal){
+  (void)signal;
+  interrupt.request();
+}
+
+//Reads standard input on its own thread so that %interrupt is seen while the kernel is busy.
+//Every other line is passed on to the REPL, and the end of input as %exit
+void read_input(ThreadSafeQueue<std::string>* lines){
+  std::string line;
+  while(std::getline(std::cin, line)){
+    if(line == "%interrupt" && busy){
+      interrupt.request();
+    }
+    else{
+      lines->push(line);
+    }
+  }
+  lines->push("%exit");
+}
 
 
 void prompt(){
   std::cout << "\nplotscript> ";
 }
 
-std::string readline(){
+std::string readline(ThreadSafeQueue<std::string>& lines){
   std::string line;
-  std::getline(std::cin, line);
+  lines.wait_and_pop(line);
 
   return line;
 }
@@ -33,14 +66,23 @@ void info(const std::string & err_str){
   std::cout << "Info: " << err_str << std::endl;
 }
 
-//Returns the success int of evaluating an istream's plotscript expression given the input interpreter
-int eval_from_stream(std::istream & stream, Interpreter& interp){
+//Returns the success int of evaluating a plotscript program given the input interpreter. The source is a
+//StreamParser or CachedProgram, and each top-level form is read and evaluated in turn, so only one form is
+//held in memory at a time
+template <typename Source>
+int eval_program(Source & source, Interpreter& interp){
+
+  bool empty = true;
+
+  while(true){
+    StreamParser::Status status = interp.parseNext(source);
+    if(status == StreamParser::END && !empty) break;
+    if(status != StreamParser::FORM){
+      error("Invalid Program. Could not parse.");
+      return EXIT_FAILURE;
+    }
+    empty = false;
 
-  if(!interp.parseStream(stream)){
-    error("Invalid Program. Could not parse.");
-    return EXIT_FAILURE;
-  }
-  else{
     try{
       Expression exp = interp.evaluate();
     }
@@ -53,41 +95,48 @@ int eval_from_stream(std::istream & stream, Interpreter& interp){
   return EXIT_SUCCESS;
 }
 
-//Returns the success int of evaluating a file's plotscript expression given the input interpreter
+//Returns the success int of evaluating a file's plotscript program given the input interpreter.
+//Repeated runs of the same file read its binary AST cache instead of parsing it again
 int eval_from_file(std::string filename, Interpreter& interp){
       
-  std::ifstream ifs(filename);
+  CachedProgram program(filename);
 
-  if(!ifs){
+  if(!program.isOpen()){
     error("Could not open file for reading.");
     return EXIT_FAILURE;
   }
   
-  return eval_from_stream(ifs, interp);
+  return eval_program(program, interp);
 }
 
 //Evaluates an expression given a terminal flag
 int eval_from_command(std::string argexp, Interpreter& interp){
 
-  std::istringstream expression(argexp);
+  StreamParser parser(argexp.data(), argexp.size());
 
-  return eval_from_stream(expression, interp);
+  return eval_program(parser, interp);
 }
 
 // A REPL is a repeated read-eval-print loop
-void repl(ThreadSafeQueue<std::string>& input_queue, ThreadSafeQueue<std::pair<std::string, Expression>>& output_queue){
+void repl(RingQueue<std::string>& input_queue, RingQueue<std::pair<std::string, Expression>>& output_queue){
   std::pair<std::string, Expression> ret;
 
-  while(!std::cin.eof()){
+  ThreadSafeQueue<std::string> lines;
+  std::thread reader(read_input, &lines);
+  reader.detach(); //blocks in getline until the end of input, so it is never joined
+
+  std::signal(SIGINT, interrupt_handler);
+
+  while(true){
 	  prompt();
-	  std::string line = readline();
+	  std::string line = readline(lines);
 
 	  if (line == "%exit") { //%exit kills the kernel
-		  input_queue.push("die");
+		  if (main_thread.joinable()) input_queue.push("die");
 		  break;
 	  }
 	  else if (line == "%start" && !main_thread.joinable()) { //%start starts a new kernel if it is not active
-		  Worker new_worker(&input_queue, &output_queue);
+		  Worker new_worker(&input_queue, &output_queue, &interrupt);
 		  main_thread = std::thread(new_worker);
 	  }
 	  else if (line == "%stop" && main_thread.joinable()) { //%stop stops the kernel if it is active
@@ -97,21 +146,32 @@ void repl(ThreadSafeQueue<std::string>& input_queue, ThreadSafeQueue<std::pair<s
 	  else if (line == "%reset" && main_thread.joinable()) { //%reset kills the kernel and starts new if it is active, 
 		  input_queue.push("die");
 		  main_thread.join();
-		  Worker new_worker(&input_queue, &output_queue);
+		  Worker new_worker(&input_queue, &output_queue, &interrupt);
 		  main_thread = std::thread(new_worker);
 	  }
 	  else if (line == "%reset" && !main_thread.joinable()) { //or starts a new one if not active
-		  Worker new_worker(&input_queue, &output_queue);
+		  Worker new_worker(&input_queue, &output_queue, &interrupt);
 		  main_thread = std::thread(new_worker);
 	  }
+	  else if (line == "%interrupt") { //%interrupt while idle has nothing to stop
+		  continue;
+	  }
+	  else if (line.compare(0, 9, "%timeout ") == 0) { //%timeout <ms> limits each evaluation, 0 for no limit
+		  interrupt.setTimeout(std::atol(line.c_str() + 9));
+		  info("evaluation timeout set to " + std::to_string(interrupt.timeout()) + " ms");
+	  }
 	  else if (!main_thread.joinable()) { //if not one of the kernel commands and the kernel is not active, error
 		  std::cerr << "Error: interpreter kernel not running" << std::endl;
 	  }
 	  else if (line.empty()) continue;
 	  else {
 
-		  input_queue.push(line);
+		  //arm the evaluation first, so an interrupt sent before the kernel starts it still stops it
+		  interrupt.arm();
+		  busy = true;
+		  input_queue.push(std::move(line));
 		  output_queue.wait_and_pop(ret);
+		  busy = false;
 
 		  if (ret.first.empty()) { //output expression
 			  std::cout << ret.second << std::endl;
@@ -124,16 +184,74 @@ void repl(ThreadSafeQueue<std::string>& input_queue, ThreadSafeQueue<std::pair<s
   }
 }
 
-int main(int argc, char *argv[])
-{  
-Interpreter interp;
+//Evaluates many scripts across a pool of kernels, each in a fresh environment forked from the startup file,
+//given the arguments after --batch:
+//  [-j kernels] [-o results file] [-t timeout ms] [-m manifest] [script ...]
+//Each script's result or error and its time are written as a line to the results file, or standard output,
+//as soon as it finishes. Returns failure if any script failed
+int eval_batch(int argc, char *argv[]){
+
+  std::size_t kernels = std::thread::hardware_concurrency();
+  std::string results;
+  long timeout = 0;
+  std::vector<std::string> paths;
+
+  for(int i = 0; i < argc; ++i){
+    std::string arg = argv[i];
+    if(arg == "-j" || arg == "-o" || arg == "-t" || arg == "-m"){
+      if(i + 1 == argc){
+        error("Missing value for " + arg + ".");
+        return EXIT_FAILURE;
+      }
+      std::string value = argv[++i];
+      if(arg == "-j") kernels = std::strtoul(value.c_str(), nullptr, 10);
+      else if(arg == "-o") results = value;
+      else if(arg == "-t") timeout = std::atol(value.c_str());
+      else{
+        std::ifstream manifest(value);
+        if(!manifest){
+          error("Could not open manifest for reading.");
+          return EXIT_FAILURE;
+        }
+        std::vector<std::string> listed = read_manifest(manifest);
+        paths.insert(paths.end(), listed.begin(), listed.end());
+      }
+    }
+    else{
+      paths.push_back(arg);
+    }
+  }
+
+  std::ofstream results_file;
+  if(!results.empty()){
+    results_file.open(results);
+    if(!results_file){
+      error("Could not open results file for writing.");
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream & out = results.empty() ? std::cout : results_file;
 
-ThreadSafeQueue<std::string> input_queue;
-ThreadSafeQueue<std::pair<std::string,Expression>> output_queue;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-Worker main_worker(&input_queue, &output_queue);
-main_thread = std::thread(main_worker);
+  KernelPool pool(startup_snapshot(), kernels);
+  pool.setTimeout(timeout);
+  std::size_t failed = run_batch(pool, paths, out);
 
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Info: " << paths.size() << " scripts, " << failed << " failed, "
+            << elapsed << " s on " << pool.metrics().kernels << " kernels" << std::endl;
+
+  return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{  
+  if(argc >= 2 && std::string(argv[1]) == "--batch"){
+    return eval_batch(argc - 2, argv + 2);
+  }
+
+  Interpreter interp;
 
   if(argc == 2){
     return eval_from_file(argv[1], interp);
@@ -147,10 +265,17 @@ main_thread = std::thread(main_worker);
     }
   }
   else{
-      repl(input_queue, output_queue);
+    //The kernel is only started for the REPL, so the other modes return without a thread to stop
+    RingQueue<std::string> input_queue;
+    RingQueue<std::pair<std::string,Expression>> output_queue;
+
+    Worker main_worker(&input_queue, &output_queue, &interrupt);
+    main_thread = std::thread(main_worker);
+
+    repl(input_queue, output_queue);
+
+    if (main_thread.joinable()) main_thread.join();
   }
-    
-  main_thread.join();
 
   return EXIT_SUCCESS;
 }
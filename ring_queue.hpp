@@ -0,0 +1,201 @@
+/*! \file ring_queue.hpp
+Defines the lock-free queue that carries inputs to a kernel and results back.
+ */
+#ifndef RING_QUEUE_HPP
+#define RING_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*! \class RingQueue
+\brief A bounded multi-producer multi-consumer FIFO queue over a ring of
+slots.
+
+Each slot carries a sequence number that says whether it is ready to be
+written or read on the current lap of the ring, so pushes and pops claim a
+slot with one compare-and-swap and never take a lock. Values are moved in
+and out, never copied.
+
+A blocking push or pop first spins on the queue, then yields, and only then
+parks on a condition variable. The spin limit adapts: it grows while
+spinning succeeds and shrinks each time a waiter has to park. A thread
+waiting on a busy kernel therefore sees each value within a fraction of a
+microsecond, and a thread waiting on an idle one sleeps. The other side
+only touches the condition variable while some thread is parked. On a
+single core spinning cannot help, so waiters go straight to yielding.
+ */
+template <typename T>
+class RingQueue {
+public:
+
+  /// construct a queue holding at least capacity values (rounded up to a
+  /// power of two)
+  explicit RingQueue(std::size_t capacity = 1024)
+    : m_mask(round_up(capacity) - 1), m_cells(new Cell[m_mask + 1]),
+      m_tail(0), m_head(0), m_sleepers(0), m_spin_limit(MIN_SPIN) {
+    for(std::size_t i = 0; i <= m_mask; ++i){
+      m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  RingQueue(const RingQueue &) = delete;
+  RingQueue & operator=(const RingQueue &) = delete;
+
+  /// move value onto the back of the queue, or return false if it is full
+  bool try_push(T && value) {
+    if(!enqueue(value)) return false;
+    wake();
+    return true;
+  }
+
+  /// move value onto the back of the queue, waiting while it is full
+  void push(T && value) {
+    wait_until([&]{ return enqueue(value); });
+    wake();
+  }
+
+  /// move the front of the queue into popped_value, or return false if it
+  /// is empty
+  bool try_pop(T & popped_value) {
+    if(!dequeue(popped_value)) return false;
+    wake();
+    return true;
+  }
+
+  /// move the front of the queue into popped_value, waiting while it is empty
+  void wait_and_pop(T & popped_value) {
+    wait_until([&]{ return dequeue(popped_value); });
+    wake();
+  }
+
+  /// true if the queue held no values when checked
+  bool empty() const {
+    std::size_t head = m_head.load(std::memory_order_acquire);
+    return m_cells[head & m_mask].seq.load(std::memory_order_acquire) != head + 1;
+  }
+
+private:
+
+  // spin limits of a blocking call before it yields, and yields before it parks
+  static const unsigned MIN_SPIN = 16;
+  static const unsigned MAX_SPIN = 4096;
+  static const unsigned YIELDS = 8;
+
+  // a slot is free for the push with ticket t when seq == t, and full for
+  // the pop with ticket t when seq == t + 1
+  struct Cell {
+    std::atomic<std::size_t> seq;
+    T value;
+  };
+
+  static std::size_t round_up(std::size_t capacity) {
+    std::size_t size = 2;
+    while(size < capacity) size <<= 1;
+    return size;
+  }
+
+  bool enqueue(T & value) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    while(true){
+      Cell & cell = m_cells[tail & m_mask];
+      std::size_t seq = cell.seq.load(std::memory_order_acquire);
+      if(seq == tail){
+        if(m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)){
+          cell.value = std::move(value);
+          cell.seq.store(tail + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(seq < tail){
+        return false; // the slot still holds the value from the last lap
+      }
+      else{
+        tail = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool dequeue(T & value) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    while(true){
+      Cell & cell = m_cells[head & m_mask];
+      std::size_t seq = cell.seq.load(std::memory_order_acquire);
+      if(seq == head + 1){
+        if(m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)){
+          value = std::move(cell.value);
+          cell.seq.store(head + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(seq < head + 1){
+        return false; // nothing has been pushed to the slot on this lap
+      }
+      else{
+        head = m_head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // run attempt until it succeeds: spin, then yield, then park
+  template <typename Attempt>
+  void wait_until(Attempt attempt) {
+    // spinning only helps when the other side can run at the same time
+    static const bool spin = std::thread::hardware_concurrency() > 1;
+    unsigned limit = m_spin_limit.load(std::memory_order_relaxed);
+    for(unsigned i = 0; spin && i < limit; ++i){
+      if(attempt()){
+        m_spin_limit.store(std::min(limit * 2, MAX_SPIN), std::memory_order_relaxed);
+        return;
+      }
+    }
+    for(unsigned i = 0; i < YIELDS; ++i){
+      std::this_thread::yield();
+      if(attempt()) return;
+    }
+    m_spin_limit.store(std::max(limit / 2, MIN_SPIN), std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(m_park_mutex);
+    m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while(!attempt()){
+      m_park.wait(lock);
+    }
+    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // wake parked threads after a push or pop changed the queue. Taking the
+  // mutex orders this with a waiter between its last attempt and its wait
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleepers.load(std::memory_order_relaxed) > 0){
+      { std::lock_guard<std::mutex> lock(m_park_mutex); }
+      m_park.notify_all();
+    }
+  }
+
+  const std::size_t m_mask;
+  std::unique_ptr<Cell[]> m_cells;
+
+  // pushes and pops claim tickets from separate cache lines
+  char m_pad0[64];
+  std::atomic<std::size_t> m_tail;
+  char m_pad1[64];
+  std::atomic<std::size_t> m_head;
+  char m_pad2[64];
+
+  std::atomic<unsigned> m_sleepers;
+  std::atomic<unsigned> m_spin_limit;
+  std::mutex m_park_mutex;
+  std::condition_variable m_park;
+};
+
+template <typename T> const unsigned RingQueue<T>::MIN_SPIN;
+template <typename T> const unsigned RingQueue<T>::MAX_SPIN;
+template <typename T> const unsigned RingQueue<T>::YIELDS;
+
+#endif
@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include "ring_queue.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test ring queue order and capacity", "[ring_queue]" ) {
+
+  RingQueue<std::string> queue(3);
+  REQUIRE(queue.empty());
+
+  INFO("capacity is rounded up to a power of two");
+  REQUIRE(queue.try_push("a"));
+  REQUIRE(queue.try_push("b"));
+  REQUIRE(queue.try_push("c"));
+  REQUIRE(queue.try_push("d"));
+  REQUIRE(!queue.try_push("e"));
+  REQUIRE(!queue.empty());
+
+  INFO("values come out in the order they went in, across laps of the ring");
+  std::string value;
+  for(int lap = 0; lap < 3; ++lap){
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(value == "a");
+    queue.push("a");
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(value == "b");
+    queue.push("b");
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(value == "c");
+    queue.push("c");
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(value == "d");
+    queue.push("d");
+  }
+
+  for(const char * expected : {"a", "b", "c", "d"}){
+    queue.wait_and_pop(value);
+    REQUIRE(value == expected);
+  }
+  REQUIRE(queue.empty());
+  REQUIRE(!queue.try_pop(value));
+}
+
+TEST_CASE( "Test ring queue moves values", "[ring_queue]" ) {
+
+  RingQueue<std::unique_ptr<int>> queue(2);
+  std::unique_ptr<int> in(new int(7));
+  queue.push(std::move(in));
+  REQUIRE(in == nullptr);
+
+  std::unique_ptr<int> out;
+  queue.wait_and_pop(out);
+  REQUIRE(*out == 7);
+}
+
+TEST_CASE( "Test ring queue between threads", "[ring_queue]" ) {
+
+  // a small ring, so producers and consumers both wait and park
+  RingQueue<long> queue(4);
+  const long per_producer = 20000;
+  const int producers = 3;
+  const int consumers = 2;
+
+  std::vector<std::thread> threads;
+  for(int p = 0; p < producers; ++p){
+    threads.emplace_back([&queue, per_producer]{
+      for(long i = 1; i <= per_producer; ++i) queue.push(long(i));
+    });
+  }
+
+  std::vector<long> sums(consumers, 0);
+  for(int c = 0; c < consumers; ++c){
+    threads.emplace_back([&queue, &sums, c, per_producer, producers, consumers]{
+      long value;
+      for(long i = 0; i < per_producer * producers / consumers; ++i){
+        queue.wait_and_pop(value);
+        sums[c] += value;
+      }
+    });
+  }
+
+  for(auto & t : threads) t.join();
+
+  REQUIRE(sums[0] + sums[1] == producers * per_producer * (per_producer + 1) / 2);
+  REQUIRE(queue.empty());
+}
@@ -0,0 +1,190 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+
+struct ThreadPool::Batch {
+  const std::function<void(std::size_t)> * body;
+
+  // set once a call has thrown, so the rest are skipped
+  std::atomic<bool> failed;
+  std::exception_ptr error;
+
+  // calls not yet finished, guarded by mutex so that the batch outlives the
+  // thread that finishes the last one
+  std::size_t remaining;
+  std::mutex mutex;
+  std::condition_variable done;
+};
+
+// the pool and queue of the calling thread if it is a worker
+static thread_local ThreadPool * worker_pool = nullptr;
+static thread_local std::size_t worker_index = 0;
+
+ThreadPool::ThreadPool(std::size_t count): queued(0), stopping(false){
+
+  if(count == 0) count = 1;
+
+  for(std::size_t i = 0; i < count; ++i){
+    queues.emplace_back(new Queue);
+  }
+  for(std::size_t i = 0; i < count; ++i){
+    threads.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard<std::mutex> lock(park_mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+
+  for(auto & thread : threads){
+    thread.join();
+  }
+}
+
+std::size_t ThreadPool::size() const noexcept{
+  return threads.size();
+}
+
+std::size_t ThreadPool::chunks(std::size_t count) const noexcept{
+  // the submitting thread counts as a worker too
+  return std::min(count, 4 * (threads.size() + 1));
+}
+
+ThreadPool & ThreadPool::shared(){
+  static ThreadPool pool(std::thread::hardware_concurrency());
+  return pool;
+}
+
+void ThreadPool::run(std::size_t count, const std::function<void(std::size_t)> & body){
+
+  if(count == 0){
+    return;
+  }
+
+  Batch batch;
+  batch.body = &body;
+  batch.failed = false;
+  batch.remaining = count;
+
+  // counted before they are published, so a worker that claims one at once
+  // never takes the count below zero
+  queued.fetch_add(count);
+
+  // a worker keeps the tasks to itself until they are stolen; anyone else
+  // deals them out so every worker can start at once
+  std::size_t own = (worker_pool == this) ? worker_index : queues.size();
+  for(std::size_t i = 0; i < count; ++i){
+    Queue & queue = *queues[(own < queues.size()) ? own : i % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(Task{&batch, i});
+  }
+  {
+    std::lock_guard<std::mutex> lock(park_mutex);
+  }
+  work_available.notify_all();
+
+  // help with this batch's tasks until they have all been claimed, then wait
+  // for the rest to finish. Other callers' tasks are left to the workers, as
+  // they may take long or nest runs of their own
+  Task task;
+  while(claim(own, task, &batch)){
+    execute(task);
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    if(batch.remaining == 0) break;
+  }
+  {
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch]{ return batch.remaining == 0; });
+  }
+
+  if(batch.error){
+    std::rethrow_exception(batch.error);
+  }
+}
+
+void ThreadPool::work(std::size_t index){
+
+  worker_pool = this;
+  worker_index = index;
+
+  Task task;
+  while(true){
+    if(claim(index, task)){
+      execute(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(park_mutex);
+    work_available.wait(lock, [this]{ return stopping || queued.load() > 0; });
+    if(stopping) return;
+  }
+}
+
+bool ThreadPool::claim(std::size_t own, Task & task, const Batch * only){
+
+  if(queued.load() == 0){
+    return false;
+  }
+
+  // take the newest task of queue own, or the oldest of another, skipping
+  // those of other batches if only is given
+  auto take = [this, &task, only](Queue & queue, bool newest){
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    auto match = [only](const Task & t){ return (only == nullptr) || (t.batch == only); };
+    std::deque<Task>::iterator it;
+    if(newest){
+      auto found = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), match);
+      if(found == queue.tasks.rend()) return false;
+      it = std::prev(found.base());
+    }
+    else{
+      it = std::find_if(queue.tasks.begin(), queue.tasks.end(), match);
+      if(it == queue.tasks.end()) return false;
+    }
+    task = *it;
+    queue.tasks.erase(it);
+    queued.fetch_sub(1);
+    return true;
+  };
+
+  if((own < queues.size()) && take(*queues[own], true)){
+    return true;
+  }
+
+  // steal from the other queues, starting after our own
+  std::size_t n = queues.size();
+  std::size_t start = (own < n) ? own + 1 : 0;
+  for(std::size_t i = 0; i < n; ++i){
+    if(take(*queues[(start + i) % n], false)){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::execute(const Task & task){
+
+  Batch & batch = *task.batch;
+
+  if(!batch.failed.load()){
+    try{
+      (*batch.body)(task.index);
+    }
+    catch(...){
+      std::lock_guard<std::mutex> lock(batch.mutex);
+      if(!batch.error) batch.error = std::current_exception();
+      batch.failed = true;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(batch.mutex);
+  if(--batch.remaining == 0){
+    batch.done.notify_all();
+  }
+}
@@ -0,0 +1,89 @@
+/*! \file thread_pool.hpp
+Defines the work-stealing thread pool that parallel built-ins run on.
+ */
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \class ThreadPool
+\brief A fixed set of worker threads, each with its own deque of tasks.
+
+A worker takes tasks from the back of its own deque and, when that is
+empty, steals from the front of the others', so work spreads out without a
+central queue. The thread that submits work takes part in running it, which
+lets a task submit work of its own (a parallel map inside a parallel map)
+without tying up a worker. It only helps with its own tasks, so it never
+ends up running, or waiting behind, another caller's work.
+ */
+class ThreadPool {
+public:
+
+  /// start a pool of the given number of worker threads (at least one)
+  explicit ThreadPool(std::size_t threads);
+
+  /// stop and join the workers; no run may be in progress
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /// the number of worker threads
+  std::size_t size() const noexcept;
+
+  /*! Call body(i) for each i in [0, count), spread across the pool and the
+    calling thread, and return when every call has finished. If a call
+    throws, the calls not yet started are skipped and the first exception
+    is rethrown here.
+   */
+  void run(std::size_t count, const std::function<void(std::size_t)> & body);
+
+  /// how many chunks to split count items into for run: a few per worker,
+  /// so that stealing evens out chunks that take longer, and at most count
+  std::size_t chunks(std::size_t count) const noexcept;
+
+  /// the pool shared by the interpreter, with one worker per core
+  static ThreadPool & shared();
+
+private:
+
+  // the calls of one run, which lives on the stack of the submitting thread
+  struct Batch;
+
+  struct Task {
+    Batch * batch;
+    std::size_t index;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  // tasks waiting in any queue, and where idle workers park until there are some
+  std::atomic<std::size_t> queued;
+  std::mutex park_mutex;
+  std::condition_variable work_available;
+  bool stopping;
+
+  void work(std::size_t index);
+
+  // claim a task, from queue own first if it is a valid index, and only one
+  // of batch only if that is given
+  bool claim(std::size_t own, Task & task, const Batch * only = nullptr);
+
+  static void execute(const Task & task);
+};
+
+#endif
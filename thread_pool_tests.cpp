@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include "thread_pool.hpp"
+#include "semantic_error.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test thread pool runs every call", "[thread_pool]" ) {
+
+  ThreadPool pool(3);
+  REQUIRE(pool.size() == 3);
+
+  std::vector<int> calls(1000, 0);
+  pool.run(calls.size(), [&calls](std::size_t i){ calls[i] += 1; });
+  for(int count : calls){
+    REQUIRE(count == 1);
+  }
+
+  INFO("a run with nothing to do returns at once");
+  pool.run(0, [](std::size_t){ throw SemanticError("not called"); });
+}
+
+TEST_CASE( "Test thread pool runs nested work", "[thread_pool]" ) {
+
+  // more outer calls than workers, each waiting on inner calls
+  ThreadPool pool(2);
+  std::atomic<int> total(0);
+  pool.run(8, [&pool, &total](std::size_t){
+    pool.run(50, [&total](std::size_t i){ total += static_cast<int>(i); });
+  });
+  REQUIRE(total == 8 * (49 * 50 / 2));
+}
+
+TEST_CASE( "Test thread pool rethrows the first error", "[thread_pool]" ) {
+
+  ThreadPool pool(2);
+  std::atomic<int> started(0);
+  REQUIRE_THROWS_AS(pool.run(100, [&started](std::size_t){
+    ++started;
+    throw SemanticError("Error: every call");
+  }), SemanticError);
+
+  INFO("once a call has thrown no thread starts another, so at most one per thread ran");
+  REQUIRE(started >= 1);
+  REQUIRE(started <= static_cast<int>(pool.size()) + 1);
+
+  INFO("the pool is still usable afterwards");
+  std::atomic<int> calls(0);
+  pool.run(10, [&calls](std::size_t){ ++calls; });
+  REQUIRE(calls == 10);
+}
+
+// set on the thread running the small batch below
+static thread_local bool small_caller = false;
+
+TEST_CASE( "Test thread pool callers only run their own calls", "[thread_pool]" ) {
+
+  ThreadPool pool(2);
+  std::atomic<bool> release(false);
+  std::atomic<int> blocked(0);
+  std::atomic<bool> foreign(false);
+
+  // another caller's calls hold both workers and its own thread until released
+  std::thread other([&](){
+    pool.run(8, [&](std::size_t){
+      if(small_caller) foreign = true;
+      ++blocked;
+      while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+  });
+  while(blocked < 3) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // a small run finishes on the calling thread without waiting behind them
+  std::atomic<int> calls(0);
+  std::future<void> small = std::async(std::launch::async, [&](){
+    small_caller = true;
+    pool.run(4, [&calls](std::size_t){ ++calls; });
+  });
+  bool finished = (small.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+  release = true;
+  small.get();
+  other.join();
+
+  REQUIRE(finished);
+  REQUIRE(calls == 4);
+  REQUIRE(!foreign);
+}
@@ -2,7 +2,9 @@
 
 // system includes
 #include <cctype>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 
 // define constants for special characters
 const char OPENCHAR = '(';
@@ -43,61 +45,103 @@ std::string Token::asString() const{
 }
 
 
-// add token to sequence unless it is empty, clears token
-void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
-  if(!token.empty()){
-    seq.emplace_back(token);
-    token.clear();
+std::string TokenView::asString(const char * buffer) const{
+  switch(type){
+  case Token::OPEN:
+    return "(";
+  case Token::CLOSE:
+    return ")";
+  default:
+    return std::string(buffer + offset, length);
   }
 }
 
 TokenSequenceType tokenize(std::istream & seq){
+  std::string buffer((std::istreambuf_iterator<char>(seq)), std::istreambuf_iterator<char>());
+
   TokenSequenceType tokens;
-  std::string token;
-  bool quoteFlag = false;
-  
-  while(true){
-    char c = seq.get();
-    if(seq.eof()) break;
-    
-    if(c == COMMENTCHAR){
-      // chomp until the end of the line
-      while((!seq.eof()) && (c != '\n')){
-		c = seq.get();
-      }
-      if(seq.eof()) break;
+  for(const TokenView & view : tokenize(buffer.data(), buffer.size())){
+    if(view.type == Token::OPEN || view.type == Token::CLOSE){
+      tokens.emplace_back(view.type);
+    }
+    else{
+      tokens.emplace_back(view.asString(buffer.data()));
+    }
+  }
+
+  return tokens;
+}
+
+// add the token from start to end to the sequence unless it is empty
+static inline void store_ifnot_empty(const char * buffer, const char * start, const char * end,
+                                     TokenViewSequenceType & tokens){
+  if(start != end){
+    Token::TokenType type = (*start == QUOTECHAR) ? Token::QUOTE : Token::STRING;
+    tokens.push_back({type, static_cast<std::size_t>(start - buffer), static_cast<std::size_t>(end - start)});
+  }
+}
+
+// the class of every char, so a scan is one table load per character
+static const struct CharClassTable {
+  CharClass table[256];
+  CharClassTable(){
+    for(int c = 0; c < 256; ++c){
+      table[c] = std::isspace(c) ? CHAR_SPACE : CHAR_PLAIN;
     }
-    else if(c == OPENCHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::OPEN);
+    table[static_cast<unsigned char>(OPENCHAR)] = CHAR_SPECIAL;
+    table[static_cast<unsigned char>(CLOSECHAR)] = CHAR_SPECIAL;
+    table[static_cast<unsigned char>(COMMENTCHAR)] = CHAR_SPECIAL;
+    table[static_cast<unsigned char>(QUOTECHAR)] = CHAR_SPECIAL;
+  }
+} char_classes;
+
+const CharClass * char_class_table() noexcept{
+  return char_classes.table;
+}
+
+TokenViewSequenceType tokenize(const char * buffer, std::size_t size){
+  TokenViewSequenceType tokens;
+  // a rough guess of one token per eight characters saves most regrowth
+  tokens.reserve(size / 8);
+
+  const CharClass * classes = char_class_table();
+  const char * end = buffer + size;
+  const char * token = buffer; // start of the current token
+  const char * c = buffer;
+
+  while(c != end){
+    CharClass cls = classes[static_cast<unsigned char>(*c)];
+    if(cls == CHAR_PLAIN){
+      ++c;
     }
-    else if(c == CLOSECHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::CLOSE);
+    else if(cls == CHAR_SPACE){
+      store_ifnot_empty(buffer, token, c, tokens);
+      token = ++c;
     }
-	else if (c == QUOTECHAR) {
-		if (quoteFlag) {
-			token.push_back(c);
-			store_ifnot_empty(token, tokens);
-			quoteFlag = false;
-			continue;
-		}
-		token.push_back(c);
-		quoteFlag = true;
-	}
-    else if(isspace(c)){
-		if (!quoteFlag) {
-			store_ifnot_empty(token, tokens);
-		}
-		else {
-			token.push_back(c);
-		}
+    else if(*c == COMMENTCHAR){
+      store_ifnot_empty(buffer, token, c, tokens);
+      // chomp until the end of the line
+      const char * eol = static_cast<const char *>(std::memchr(c, '\n', end - c));
+      if(eol == nullptr){
+        c = end;
+        break;
+      }
+      token = c = eol + 1;
+    }
+    else if(*c == QUOTECHAR){
+      // the string runs to the closing quote, which ends the token
+      const char * close = static_cast<const char *>(std::memchr(c + 1, QUOTECHAR, end - c - 1));
+      c = (close == nullptr) ? end : close + 1;
+      store_ifnot_empty(buffer, token, c, tokens);
+      token = c;
     }
     else{
-      token.push_back(c);
+      store_ifnot_empty(buffer, token, c, tokens);
+      tokens.push_back({(*c == OPENCHAR) ? Token::OPEN : Token::CLOSE, static_cast<std::size_t>(c - buffer), 1});
+      token = ++c;
     }
   }
-  store_ifnot_empty(token, tokens);
+  store_ifnot_empty(buffer, token, c, tokens);
 
   return tokens;
 }
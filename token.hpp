@@ -4,8 +4,11 @@ Defines the Token and TokenSequence types, and associated functions.
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include <cstddef>
 #include <deque>
 #include <istream>
+#include <string>
+#include <vector>
 
 /*! \class Token
   \brief Value class representing a token.
@@ -41,6 +44,44 @@ private:
   std::string value;
 };
 
+/*! \struct TokenView
+  \brief A token as a view into the buffer it was read from.
+
+  A TokenView does not own any characters: OPEN and CLOSE have no text, and
+  STRING or QUOTE tokens are the length characters at offset in the buffer
+  given to tokenize. The buffer must outlive the views.
+*/
+struct TokenView {
+  /// the tag type of the token
+  Token::TokenType type;
+
+  /// offset of the first character of the token in the buffer
+  std::size_t offset;
+
+  /// number of characters in the token
+  std::size_t length;
+
+  /// return the token's text, given the buffer it was read from
+  std::string asString(const char * buffer) const;
+};
+
+/*! \typedef TokenViewSequenceType
+Define the token view sequence, contiguous so tokenizing a buffer does one
+allocation per doubling rather than per token.
+ */
+typedef std::vector<TokenView> TokenViewSequenceType;
+
+/*! \enum CharClass
+  \brief How the tokenizers treat each character.
+*/
+enum CharClass : unsigned char { CHAR_PLAIN,   //< part of a token
+                                 CHAR_SPACE,   //< whitespace, ends a token
+                                 CHAR_SPECIAL  //< one of ( ) ; or "
+};
+
+/// return a table of the CharClass of every char, indexed as unsigned char
+const CharClass * char_class_table() noexcept;
+
 /*! \typedef TokenSequenceType
 Define the token sequence using a std container. Any supporting 
 sequential access should do.
@@ -60,4 +101,17 @@ Ignores any whitespace and comments (from any ";" to end-of-line).
 */
 TokenSequenceType tokenize(std::istream & seq);
 
+/*! \fn TokenViewSequenceType tokenize(const char * buffer, std::size_t size)
+\brief Split a buffer into a sequence of token views, without copying
+
+\param buffer the input characters, such as a memory-mapped file
+\param size the number of characters in buffer
+\return The sequence of tokens, as offsets into buffer
+
+Splits as tokenize(std::istream &) does, in a single pass over the buffer.
+Inside a quoted string every character up to the closing quote, including
+parentheses and ";", is part of the token.
+*/
+TokenViewSequenceType tokenize(const char * buffer, std::size_t size);
+
 #endif
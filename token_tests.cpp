@@ -121,3 +121,26 @@ TEST_CASE("Test tokenize on a string with spaces", "[token]") {
 	REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE("Test tokenize a buffer into views", "[token]") {
+	std::string input = "(define s \"a (b) ; c\") ; a comment\n(+ 1 2.5)";
+
+	TokenViewSequenceType tokens = tokenize(input.data(), input.size());
+
+	std::vector<Token::TokenType> types = { Token::OPEN, Token::STRING, Token::STRING, Token::QUOTE, Token::CLOSE,
+		Token::OPEN, Token::STRING, Token::STRING, Token::STRING, Token::CLOSE };
+	std::vector<std::string> text = { "(", "define", "s", "\"a (b) ; c\"", ")", "(", "+", "1", "2.5", ")" };
+
+	REQUIRE(tokens.size() == types.size());
+	for (std::size_t i = 0; i < tokens.size(); ++i) {
+		REQUIRE(tokens[i].type == types[i]);
+		REQUIRE(tokens[i].asString(input.data()) == text[i]);
+	}
+
+	// the views point into the buffer
+	REQUIRE(tokens[1].offset == 1);
+	REQUIRE(tokens[1].length == 6);
+	REQUIRE(input.compare(tokens[3].offset, tokens[3].length, "\"a (b) ; c\"") == 0);
+
+	REQUIRE(tokenize(input.data(), 0).empty());
+}
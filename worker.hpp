@@ -1,9 +1,12 @@
 #ifndef WORKER_HPP
 #define WORKER_HPP
 
-#include "ThreadSafeQueue.hpp"
+#include "ast_cache.hpp"
 #include "expression.hpp"
 #include "interpreter.hpp"
+#include "interrupt.hpp"
+#include "kernel_pool.hpp"
+#include "ring_queue.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
 
@@ -12,60 +15,76 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <functional>
+#include <memory>
+
+//The environment after evaluating the startup file, built once per process. Every kernel forks it, so starting
+//or resetting a kernel does not read the startup file or rebuild the built-ins again
+inline std::shared_ptr<const Environment> startup_snapshot()
+{
+	static const std::shared_ptr<const Environment> snapshot = [] {
+		Interpreter interp;
+		//The startup file is read from its binary AST cache when that is current
+		CachedProgram startup(STARTUP_FILE);
+		try {
+			while (interp.parseNext(startup) == StreamParser::FORM) {
+				interp.evaluate();
+			}
+		}
+		catch (const SemanticError & ex) {
+			std::cerr << "Error in startup file: " << ex.what() << std::endl;
+		}
+		return interp.snapshot();
+	}();
+	return snapshot;
+}
 
 //Worker class for the producer/consumer structure of handling the programs threads
 class Worker
 {
 public:
 
-	//And instance takes in q1 as the input queue and q2 as the output queue
-	Worker(ThreadSafeQueue<std::string> *q1, ThreadSafeQueue<std::pair<std::string,Expression>> *q2)
+	//And instance takes in q1 as the input queue and q2 as the output queue. Inputs and results are moved
+	//through the queues, not copied. If interrupt is given
+	//it is polled during each evaluation, so it can be stopped (see Interrupt) without killing the kernel.
+	//If notify is given it is called on the kernel thread after each result is pushed, so a consumer
+	//can be told about results instead of blocking on q2
+	Worker(RingQueue<std::string> *q1, RingQueue<std::pair<std::string,Expression>> *q2,
+		Interrupt *interrupt = nullptr, std::function<void()> notify = std::function<void()>())
 	{
 		m_queue_in = q1;
 		m_queue_out = q2;
+		m_interrupt = interrupt;
+		m_notify = notify;
 	}
 
 
 	void operator()() const
 	{
-		Interpreter interp;
-
-		std::ifstream ifs(STARTUP_FILE);
-		interp.parseStream(ifs);
-		Expression temp = interp.evaluate();
+		Interpreter interp(startup_snapshot());
+		interp.setInterrupt(m_interrupt);
 
 		//While the worker is active
 		while (true) {
 			std::string line;
 			m_queue_in->wait_and_pop(line); //Wait for an input from the message queue and pop it as a string to parse
 			if (line == "die") break; //Die is a keyword to kill the kernel and break the loop
-			std::istringstream expression(line);
 
-			std::pair<std::string, Expression> returnPair;
+			//Parse and evaluate the line as a kernel of the pool does. An error (including an interrupt) is sent
+			//through the output string, and the environment keeps everything defined before it
+			std::pair<std::string, Expression> returnPair = evaluate_input(interp, line, m_interrupt);
 
-			if (!interp.parseStream(expression)) {
-				returnPair.first = "Error: Invalid Expression. Could not parse.";
-			}
-			else {
-				try {
-					//If a successful parse with no semantic errors, make the output string blank and set the output expression to the evaluation
-					returnPair.first = "";
-					returnPair.second = interp.evaluate();
-				}
-				catch (const SemanticError & ex) {
-					//If an error gets thrown, send it through the output string
-					returnPair.first = ex.what();
-				}
-			}
 			//Push the evaluation to the output message queue
-			m_queue_out->push(returnPair);
+			m_queue_out->push(std::move(returnPair));
+			if (m_notify) m_notify();
 		}
 	}
 
 private:
-	ThreadSafeQueue<std::string> * m_queue_in;
-	ThreadSafeQueue<std::pair<std::string, Expression>> * m_queue_out;
-	Interpreter interp;
+	RingQueue<std::string> * m_queue_in;
+	RingQueue<std::pair<std::string, Expression>> * m_queue_out;
+	Interrupt * m_interrupt;
+	std::function<void()> m_notify;
 };
 
 